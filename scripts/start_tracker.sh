@@ -1 +1 @@
-./tracker -img $1/$2/00000001.jpg -gt $1/$2/groundtruth.txt -npart $3
+./tracker -img $1/$2/00000001.jpg -gt $1/$2/groundtruth.txt -npart $3 "${@:4}"
@@ -0,0 +1,76 @@
+#include "color_histogram.hpp"
+#include "../utils/profiler.hpp"
+#include <algorithm>
+using namespace cv;
+using namespace std;
+
+ColorHistogram::ColorHistogram(){
+	bins = H_BINS*S_BINS;
+	rows = 0;
+	cols = 0;
+	// same bin edges as calc_hist_hsv: hue over [0,180), saturation over [0,255)
+	hueBin.resize(256);
+	saturationBin.resize(256);
+	for (int v=0; v<256; v++)
+	{
+		hueBin[v] = min(v*H_BINS/180, H_BINS-1);
+		saturationBin[v] = min(v*S_BINS/255, S_BINS-1);
+	}
+}
+
+/* One pass over the frame: row r of the integral histogram is row r-1 plus
+the running bin counts of image row r-1. */
+void ColorHistogram::setFrame(Mat& _frame)
+{
+	PROFILE_SCOPE("feature.color_histogram.frame");
+	cvtColor(_frame, hsv, COLOR_BGR2HSV);
+	rows = hsv.rows;
+	cols = hsv.cols;
+	int stride = (cols+1)*bins;
+	integralHistogram.assign((rows+1)*stride, 0);
+	vector<int> runningCount(bins);
+	for (int y=0; y<rows; y++)
+	{
+		const uchar* pixel = hsv.ptr<uchar>(y);
+		const int* previous = &integralHistogram[y*stride];
+		int* current = &integralHistogram[(y+1)*stride];
+		fill(runningCount.begin(), runningCount.end(), 0);
+		for (int x=0; x<cols; x++, pixel+=3)
+		{
+			runningCount[hueBin[pixel[0]]*S_BINS + saturationBin[pixel[1]]]++;
+			int offset = (x+1)*bins;
+			for (int b=0; b<bins; b++) current[offset+b] = previous[offset+b] + runningCount[b];
+		}
+	}
+}
+
+void ColorHistogram::getFeatureValue(vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue)
+{
+	PROFILE_SCOPE("feature.color_histogram");
+	PROFILE_COUNT("features_computed",bins*_sampleBox.size());
+	int stride = (cols+1)*bins;
+	int sampleBoxSize = _sampleBox.size();
+	#pragma omp parallel for
+	for (int j=0; j<sampleBoxSize; j++)
+	{
+		int x0 = min(max(_sampleBox[j].x, 0), cols);
+		int y0 = min(max(_sampleBox[j].y, 0), rows);
+		int x1 = min(max(_sampleBox[j].x + _sampleBox[j].width, 0), cols);
+		int y1 = min(max(_sampleBox[j].y + _sampleBox[j].height, 0), rows);
+		int area = (x1-x0)*(y1-y0);
+		if (area <= 0)
+		{
+			_featureValue.row(j).setZero();
+			continue;
+		}
+		const int* topLeft = &integralHistogram[y0*stride + x0*bins];
+		const int* topRight = &integralHistogram[y0*stride + x1*bins];
+		const int* bottomLeft = &integralHistogram[y1*stride + x0*bins];
+		const int* bottomRight = &integralHistogram[y1*stride + x1*bins];
+		real_t scale = (real_t)1.0/area;
+		for (int b=0; b<bins; b++)
+		{
+			_featureValue(j,b) = scale*(bottomRight[b] - bottomLeft[b] - topRight[b] + topLeft[b]);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+/**
+ * @file color_histogram.hpp
+ * @brief HSV color histograms of many boxes from per-bin integral histograms
+ * @details The frame is converted to HSV and quantized into the H_BINS x
+ * S_BINS bins of calc_hist_hsv once, while building one integral image per
+ * bin. The histogram of any box is then four lookups per bin, whatever its
+ * size, instead of a cvtColor and calcHist per box. setFrame() is called once
+ * per frame, the particles and the training boxes of that frame share it.
+ */
+#ifndef COLOR_HISTOGRAM_H
+#define COLOR_HISTOGRAM_H
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <Eigen/Dense>
+#include "hist.hpp"
+#include "../utils/real.hpp"
+
+using std::vector;
+using namespace cv;
+using namespace Eigen;
+
+class ColorHistogram{
+public:
+	ColorHistogram();
+	int getFeatureSize(){ return bins; }
+	/** converts, quantizes and integrates a BGR frame */
+	void setFrame(Mat& _frame);
+	/** normalized H x S histogram of every box, one row per box, of the last setFrame() */
+	void getFeatureValue(vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue);
+private:
+	int bins;
+	int rows, cols; /** size of the current frame */
+	vector<int> hueBin, saturationBin; /** quantization tables of the 8 bit channels */
+	Mat hsv;
+	vector<int> integralHistogram; /** (rows+1) x (cols+1) x bins, bins innermost */
+};
+
+#endif // COLOR_HISTOGRAM_H
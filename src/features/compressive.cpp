@@ -0,0 +1,87 @@
+#include "compressive.hpp"
+#include "../utils/profiler.hpp"
+#include <math.h>
+using namespace cv;
+using namespace std;
+
+const double MIN_RECT_FRACTION=0.1; /** smallest rectangle side, relative to the box */
+
+Compressive::Compressive(){
+	featureNum = 0;
+	featureMinNumRect = 2;
+	featureMaxNumRect = 4;	// number of rectangle from 2 to 3
+}
+
+/* Very sparse measurement matrix: 2 or 3 non-zeros per feature, random signs.
+Rectangle sides are log-uniform between MIN_RECT_FRACTION and the whole box,
+so the pool covers fine and coarse scales alike. */
+void Compressive::init(int _featureNum)
+{
+	featureNum = _featureNum;
+	rowStart.assign(featureNum+1, 0);
+	vector<int> numRect(featureNum);
+	for (int i=0; i<featureNum; i++)
+	{
+		numRect[i] = min(featureMinNumRect + (int)(generator.uniform()*(featureMaxNumRect-featureMinNumRect)), featureMaxNumRect-1);
+		rowStart[i+1] = rowStart[i] + numRect[i];
+	}
+	int tableSize = rowStart[featureNum];
+	left.resize(tableSize);
+	top.resize(tableSize);
+	right.resize(tableSize);
+	bottom.resize(tableSize);
+	weight.resize(tableSize);
+	for (int i=0; i<featureNum; i++)
+	{
+		for (int k=rowStart[i]; k<rowStart[i+1]; k++)
+		{
+			float width = (float)exp(log(MIN_RECT_FRACTION)*(1.0 - generator.uniform()));
+			float height = (float)exp(log(MIN_RECT_FRACTION)*(1.0 - generator.uniform()));
+			left(k) = (float)(generator.uniform()*(1.0f-width));
+			top(k) = (float)(generator.uniform()*(1.0f-height));
+			right(k) = left(k) + width;
+			bottom(k) = top(k) + height;
+			weight(k) = (real_t)(((generator.uniform() < 0.5) ? 1.0 : -1.0) / sqrt((double)numRect[i]));
+		}
+	}
+}
+
+// One row per sample, written in place; boxes are independent so they are
+// spread over OpenMP threads, each with its own corner buffers.
+void Compressive::getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue)
+{
+	PROFILE_SCOPE("feature.compressive");
+	PROFILE_COUNT("features_computed",featureNum*_sampleBox.size());
+	integral(_frame, imageIntegral, CV_32S);
+	const int* sum = imageIntegral.ptr<int>(0);
+	int step = (int)imageIntegral.step1();
+	int maxX = imageIntegral.cols-1;
+	int maxY = imageIntegral.rows-1;
+	int tableSize = weight.size();
+	int sampleBoxSize = _sampleBox.size();
+	#pragma omp parallel
+	{
+		ArrayXi x0(tableSize), x1(tableSize), y0(tableSize), y1(tableSize);
+		ArrayXr rectSum(tableSize);
+		#pragma omp for
+		for (int j=0; j<sampleBoxSize; j++)
+		{
+			const Rect& box = _sampleBox[j];
+			// every rectangle of the table at this box's position and scale, clamped to the image
+			x0 = (box.x + (left*box.width).round().cast<int>()).max(0).min(maxX);
+			x1 = (box.x + (right*box.width).round().cast<int>()).max(0).min(maxX);
+			y0 = (box.y + (top*box.height).round().cast<int>()).max(0).min(maxY);
+			y1 = (box.y + (bottom*box.height).round().cast<int>()).max(0).min(maxY);
+			for (int k=0; k<tableSize; k++)
+			{
+				rectSum(k) = (real_t)(sum[y1(k)*step+x1(k)] - sum[y0(k)*step+x1(k)]
+					- sum[y1(k)*step+x0(k)] + sum[y0(k)*step+x0(k)]);
+			}
+			rectSum *= weight / (real_t)max(box.area(), 1);
+			for (int i=0; i<featureNum; i++)
+			{
+				_featureValue(j,i) = rectSum.segment(rowStart[i], rowStart[i+1]-rowStart[i]).sum();
+			}
+		}
+	}
+}
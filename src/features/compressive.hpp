@@ -0,0 +1,41 @@
+/**
+ * @file compressive.hpp
+ * @brief compressive (sparse random projection) features over integral images
+ * @details Every feature is a sparse random measurement, the signed sum of 2
+ * or 3 rectangle sums picked at random positions and scales inside the box.
+ * The measurement matrix is stored as a CSR table of rectangles, corners as
+ * fractions of the box, so one pass over the table per box evaluates every
+ * feature at that box's scale, on an exact int32 integral image.
+ */
+#ifndef COMPRESSIVE_H
+#define COMPRESSIVE_H
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+#include <Eigen/Dense>
+#include "../utils/real.hpp"
+#include "../utils/random.hpp"
+
+using std::vector;
+using namespace cv;
+using namespace Eigen;
+
+class Compressive{
+public:
+	Compressive();
+	void init(int _featureNum);
+	int getFeatureSize(){ return featureNum; }
+	void getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue);
+private:
+	int featureNum;
+	int featureMinNumRect;
+	int featureMaxNumRect;
+	vector<int> rowStart; /** rectangles of feature i are rowStart[i]..rowStart[i+1]-1 */
+	ArrayXf left, top, right, bottom; /** rectangle corners as fractions of the box */
+	ArrayXr weight; /** +-1/sqrt(rectangles of the feature) */
+	Mat imageIntegral; /** CV_32S, exact up to 8.4M pixels of 8 bit data */
+	RandomStream generator; /** draws the measurement matrix, follows the tracker seed */
+};
+
+#endif // COMPRESSIVE_H
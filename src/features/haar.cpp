@@ -1,12 +1,18 @@
 #include "haar.hpp"
+#include "../utils/profiler.hpp"
 #include <math.h>
+#include <algorithm>
 #include <iostream>
 using namespace cv;
 using namespace std;
 
+const real_t SWAP_MARGIN=0.1; /** an outside candidate must rank 10% above the feature it replaces */
+
 //------------------------------------------------
 Haar::Haar(){
 	featureNum = 50;	// number of all weaker classifiers, i.e,feature pool
+	poolNum = 50;	// candidates ranked by updateRanking, featureNum of them are evaluated
+	ranked = false;
 	featureMinNumRect = 2;
 	featureMaxNumRect = 4;	// number of rectangle from 2 to 4
 }
@@ -57,17 +63,34 @@ void Haar::HaarFeature(Rect& _objectBox, int _numFeature){
 
 void Haar::getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox)
 {
+	sampleFeatureValue.resize(_sampleBox.size(), featureNum);
+	getFeatureValue(_frame, _sampleBox, sampleFeatureValue);
+}
+
+// Writes one row per sample straight into the caller's buffer (e.g. a block of
+// a larger training matrix), so no cv::Mat -> Eigen copy or transpose is needed.
+void Haar::getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue)
+{
+	PROFILE_SCOPE("feature.haar");
+	PROFILE_COUNT("features_computed",featureNum*_sampleBox.size());
 	integral(_frame, imageIntegral, CV_32F);
+	computeFeatures(active, _sampleBox, _featureValue);
+}
+
+// Column c of _featureValue is pool feature _index[c], on the current imageIntegral.
+void Haar::computeFeatures(const vector<int>& _index, vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue)
+{
 	int sampleBoxSize = _sampleBox.size();
-	sampleFeatureValue.create(featureNum, sampleBoxSize, CV_32F);
+	int indexSize = _index.size();
 	float tempValue;
 	int xMin;
 	int xMax;
 	int yMin;
 	int yMax;
 
-	for (int i=0; i<featureNum; i++)
+	for (int c=0; c<indexSize; c++)
 	{
+		int i = _index[c];
 		for (int j=0; j<sampleBoxSize; j++)
 		{
 			tempValue = 0.0f;
@@ -95,16 +118,108 @@ void Haar::getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox)
 						imageIntegral.at<float>(yMax, xMin));
 				}
 			}
-			sampleFeatureValue.at<float>(i,j) = tempValue;
+			_featureValue(j,c) = tempValue;
 		}
 	}
 }
 
+/* Online feature selection: every candidate of the pool keeps running
+Gaussian statistics of its response on the positive and negative examples,
+with the same forgetting as the naive Bayes update, and is ranked by the
+separation |mu_pos - mu_neg| / (sigma_pos + sigma_neg). The pool is only
+evaluated here, on the training examples, while the particles only pay for
+the featureNum active features. */
+void Haar::updateRanking(Mat& _frame, vector<Rect>& _positiveBox, vector<Rect>& _negativeBox, float _learningRate)
+{
+	PROFILE_SCOPE("feature.haar.ranking");
+	swapped.clear();
+	int numPositive = _positiveBox.size();
+	int numNegative = _negativeBox.size();
+	if (numPositive == 0 || numNegative == 0) return;
+	PROFILE_COUNT("features_computed",poolNum*(numPositive+numNegative));
+	integral(_frame, imageIntegral, CV_32F);
+	poolFeatureValue.resize(numPositive+numNegative, poolNum);
+	computeFeatures(poolIndex, _positiveBox, poolFeatureValue.topRows(numPositive));
+	computeFeatures(poolIndex, _negativeBox, poolFeatureValue.bottomRows(numNegative));
+
+	VectorXr newMuPos = poolFeatureValue.topRows(numPositive).colwise().mean().transpose();
+	VectorXr newMuNeg = poolFeatureValue.bottomRows(numNegative).colwise().mean().transpose();
+	VectorXr newVarPos = (poolFeatureValue.topRows(numPositive).rowwise() - newMuPos.transpose()).array().square().colwise().mean().transpose();
+	VectorXr newVarNeg = (poolFeatureValue.bottomRows(numNegative).rowwise() - newMuNeg.transpose()).array().square().colwise().mean().transpose();
+	if (!ranked)
+	{
+		muPos = newMuPos;
+		muNeg = newMuNeg;
+		sigmaPos = newVarPos.cwiseSqrt();
+		sigmaNeg = newVarNeg.cwiseSqrt();
+	}
+	else
+	{
+		real_t lr = _learningRate;
+		sigmaPos = ((1-lr)*sigmaPos.array().square() + lr*newVarPos.array() + lr*(1-lr)*(muPos-newMuPos).array().square()).sqrt().matrix();
+		sigmaNeg = ((1-lr)*sigmaNeg.array().square() + lr*newVarNeg.array() + lr*(1-lr)*(muNeg-newMuNeg).array().square()).sqrt().matrix();
+		muPos = (1-lr)*muPos + lr*newMuPos;
+		muNeg = (1-lr)*muNeg + lr*newMuNeg;
+	}
+	score = (muPos-muNeg).array().abs() / (sigmaPos.array() + sigmaNeg.array() + 1e-6);
+
+	if (!ranked)
+	{
+		// first ranking, nothing has been fit on the active columns yet
+		vector<int> order = poolIndex;
+		partial_sort(order.begin(), order.begin()+featureNum, order.end(),
+			[this](int a, int b){ return score(a) > score(b); });
+		active.assign(order.begin(), order.begin()+featureNum);
+		swapped.assign(poolIndex.begin(), poolIndex.begin()+featureNum);
+		ranked = true;
+	}
+	else
+	{
+		selectFeatures();
+	}
+}
+
+/* Swaps the weakest active features for the strongest candidates outside the
+active set, in place: a feature that stays keeps its column, so the
+likelihood's statistics of it remain valid across updates. The swapped
+columns are listed in swapped, their statistics have to be refit. */
+void Haar::selectFeatures()
+{
+	vector<bool> isActive(poolNum, false);
+	for (int c=0; c<featureNum; c++) isActive[active[c]] = true;
+	vector<int> outside;
+	outside.reserve(poolNum-featureNum);
+	for (int i=0; i<poolNum; i++) if (!isActive[i]) outside.push_back(i);
+	sort(outside.begin(), outside.end(), [this](int a, int b){ return score(a) > score(b); });
+	vector<int> column(featureNum);
+	for (int c=0; c<featureNum; c++) column[c] = c;
+	sort(column.begin(), column.end(), [this](int a, int b){ return score(active[a]) < score(active[b]); });
+	int k = 0;
+	for (; k<(int)outside.size() && k<featureNum; k++)
+	{
+		if (score(outside[k]) <= (1+SWAP_MARGIN)*score(active[column[k]])) break;
+		active[column[k]] = outside[k];
+		swapped.push_back(column[k]);
+	}
+	PROFILE_COUNT("haar.features_swapped",k);
+}
+
 void Haar::init(Mat& _frame, Rect& _objectBox,vector<Rect>& _sampleBox)
 {
 	// compute feature template
 	//cout << "frame:" << _frame.size() << endl; 
-	reference_roi=_objectBox;
-	HaarFeature(_objectBox, featureNum);
+	init(_objectBox);
 	getFeatureValue(_frame, _sampleBox);
 }
+
+void Haar::init(Rect& _objectBox)
+{
+	reference_roi=_objectBox;
+	poolNum = max(poolNum, featureNum);
+	HaarFeature(_objectBox, poolNum);
+	// until the first ranking the active features are arbitrary candidates
+	poolIndex.resize(poolNum);
+	for (int i=0; i<poolNum; i++) poolIndex[i] = i;
+	active.assign(poolIndex.begin(), poolIndex.begin()+featureNum);
+	ranked = false;
+}
@@ -6,18 +6,23 @@
 
 #include <vector>
 #include <Eigen/Dense>
+#include "../utils/real.hpp"
 
 using std::vector;
 using namespace cv;
+using namespace Eigen;
 
 class Haar{
 public:
     Haar();
 	~Haar();
-	vector<vector<Rect> > features;
+	vector<vector<Rect> > features; /** candidate pool, poolNum features */
 	vector<vector<float> > featuresWeight;
-	Mat sampleFeatureValue;
-	int featureNum;
+	MatrixXr sampleFeatureValue; /** samples x features */
+	int featureNum; /** features evaluated per sample */
+	int poolNum; /** candidate features, at least featureNum */
+	vector<int> active; /** pool index of the feature in every output column */
+	vector<int> swapped; /** output columns whose feature changed at the last updateRanking */
 private:
 	int featureMinNumRect;
 	int featureMaxNumRect;
@@ -25,13 +30,23 @@ private:
 	Mat detectFeatureValue;
 	RNG rng;
 	Rect reference_roi;
+	bool ranked;
+	vector<int> poolIndex; /** 0..poolNum-1 */
+	MatrixXr poolFeatureValue; /** examples x candidates, reused by updateRanking */
+	VectorXr muPos, sigmaPos, muNeg, sigmaNeg; /** running class statistics of every candidate */
+	VectorXr score;
 
 private:
 	void HaarFeature(Rect& _objectBox, int _numFeature);
+	void computeFeatures(const vector<int>& _index, vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue);
+	void selectFeatures();
 
 public:
 	void getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox);
+	void getFeatureValue(Mat& _frame, vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue);
+	void updateRanking(Mat& _frame, vector<Rect>& _positiveBox, vector<Rect>& _negativeBox, float _learningRate);
 	void init(Mat& _frame, Rect& _objectBox,vector<Rect>& _sampleBox);
+	void init(Rect& _objectBox);
 	
 };
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
  * @author Sergio Hernandez
  */
  #include "hog.hpp"
+#include "../utils/profiler.hpp"
 
 using namespace cv;
 using namespace std;
@@ -34,7 +35,8 @@ void calc_hog(Mat& image,Mat& hist){
     //normalize(hist, hist, 0, 1, NORM_MINMAX);
 }
 
-void calc_hog(Mat& image,Eigen::VectorXd& hist,cv::Size reference_size){
+void calc_hog(Mat& image,VectorXr& hist,cv::Size reference_size){
+    PROFILE_SCOPE("feature.hog");
     // default opencv implementation
     Mat part_hog;
     std::vector<float> descriptors;
@@ -46,6 +48,7 @@ void calc_hog(Mat& image,Eigen::VectorXd& hist,cv::Size reference_size){
         resize(image,part_hog,descriptor.winSize,0,0,INTER_LINEAR);
         //cvtColor(part_hog, part_hog, COLOR_RGB2GRAY);
         descriptor.compute(part_hog,descriptors,Size(0,0), Size(0,0),points);
+        PROFILE_COUNT("features_computed",descriptors.size());
         hist.setOnes(descriptors.size());
         for(unsigned int i=0;i<descriptors.size();i++){
             hist[i]=descriptors.at(i);
@@ -53,7 +56,33 @@ void calc_hog(Mat& image,Eigen::VectorXd& hist,cv::Size reference_size){
     }
 }
 
-/*void calc_hog_gpu(Mat& image,Eigen::VectorXd& hist){
+// One descriptor row per box, written in place into the caller's (preallocated)
+// matrix; boxes are independent so they are spread over OpenMP threads.
+void calc_hog(Mat& image,const std::vector<Rect>& boxes,Eigen::Ref<MatrixXr> hist,cv::Size reference_size){
+    PROFILE_SCOPE("feature.hog");
+    #pragma omp parallel for
+    for(unsigned int k=0;k<boxes.size();k++){
+        Mat part_hog;
+        std::vector<float> descriptors;
+        std::vector<Point> points;
+        HOGDescriptor descriptor;
+        descriptor.winSize=Size(64,128);
+        Mat subImage=image(boxes.at(k));
+        if(subImage.cols>0 && subImage.rows>0){
+            resize(subImage,part_hog,descriptor.winSize,0,0,INTER_LINEAR);
+            descriptor.compute(part_hog,descriptors,Size(0,0), Size(0,0),points);
+            for(unsigned int i=0;i<descriptors.size();i++){
+                hist(k,i)=descriptors.at(i);
+            }
+        }
+        else{
+            hist.row(k).setOnes();
+        }
+    }
+    PROFILE_COUNT("features_computed",hist.cols()*boxes.size());
+}
+
+/*void calc_hog_gpu(Mat& image,VectorXr& hist){
     // default opencv implementation
     Mat part_hog;
     cuda::GpuMat gpu_img;
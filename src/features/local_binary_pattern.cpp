@@ -1,4 +1,5 @@
 #include "local_binary_pattern.hpp"
+#include "../utils/profiler.hpp"
 #include <sstream>
 
 
@@ -12,6 +13,14 @@ LocalBinaryPattern::LocalBinaryPattern(){
 }
 
 void LocalBinaryPattern::getFeatureValue(Mat& _image, vector<Rect> _sampleBox, bool _isPositiveBox){
+	MatrixXr& featureValue = _isPositiveBox ? sampleFeatureValue : negativeFeatureValue;
+	featureValue.resize(_sampleBox.size(), getFeatureSize());
+	getFeatureValue(_image, _sampleBox, featureValue);
+}
+
+void LocalBinaryPattern::getFeatureValue(Mat& _image, const vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue){
+	PROFILE_SCOPE("feature.lbp");
+	PROFILE_COUNT("features_computed",numBlocks*numBlocks*59*_sampleBox.size());
 	//int xMin, xMax, yMin, yMax;
 	for (unsigned int k = 0; k < _sampleBox.size(); ++k)
 	{
@@ -59,17 +68,10 @@ void LocalBinaryPattern::getFeatureValue(Mat& _image, vector<Rect> _sampleBox, b
         	}
         }
         
-        if(_isPositiveBox){
-	        for (unsigned int i = 0; i < hist.size(); ++i)
-	        {
-	        	sampleFeatureValue(k,i) = hist[i];
-	        }
-	    }else{
-	    	for (unsigned int i = 0; i < hist.size(); ++i)
-	        {
-	        	negativeFeatureValue(k,i) = hist[i];
-	        }
-	    }
+        for (unsigned int i = 0; i < hist.size(); ++i)
+        {
+        	_featureValue(k,i) = hist[i];
+        }
 	}
 	/* size:
     -hf = 32
@@ -79,9 +81,11 @@ void LocalBinaryPattern::getFeatureValue(Mat& _image, vector<Rect> _sampleBox, b
     */
 }
 
+int LocalBinaryPattern::getFeatureSize(){
+	return numBlocks*numBlocks*59;
+}
+
 void LocalBinaryPattern::init(Mat& _image, vector<Rect> _sampleBox){
-	sampleFeatureValue = MatrixXd(_sampleBox.size(),numBlocks*numBlocks*59);
-    negativeFeatureValue = MatrixXd(_sampleBox.size(),numBlocks*numBlocks*59);
     getFeatureValue(_image, _sampleBox);
     initialized=true;
 }
@@ -20,6 +20,7 @@
 #include <float.h>
 
 #include "../libs/LBP/LBP.hpp"
+#include "../utils/real.hpp"
 
 using std::vector;
 using namespace cv;
@@ -30,8 +31,10 @@ class LocalBinaryPattern{
 	public:
 		LocalBinaryPattern();
 		void getFeatureValue(Mat& _image, vector<Rect> _sampleBox, bool _isPositiveBox=true);
+		void getFeatureValue(Mat& _image, const vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue);
 		void init(Mat& _image, vector<Rect> _sampleBox);
-		MatrixXd sampleFeatureValue, negativeFeatureValue;
+		int getFeatureSize();
+		MatrixXr sampleFeatureValue, negativeFeatureValue;
 	private:
 		bool initialized;
 		int numBlocks;
@@ -1,5 +1,6 @@
 // Author: Diego Vergara
 #include "mb_lbp.hpp"
+#include "../utils/profiler.hpp"
 
 MultiScaleBlockLBP::MultiScaleBlockLBP()
 {
@@ -18,7 +19,15 @@ MultiScaleBlockLBP::MultiScaleBlockLBP(int _p_blocks, int _n_features, int _slid
 }
 
 void MultiScaleBlockLBP::getFeatureValue(Mat& _image, vector<Rect> _sampleBox, bool _isPositiveBox){
+	MatrixXr& featureValue = _isPositiveBox ? sampleFeatureValue : negativeFeatureValue;
+	featureValue.resize(_sampleBox.size(), getFeatureSize());
+	getFeatureValue(_image, _sampleBox, featureValue);
+}
+
+void MultiScaleBlockLBP::getFeatureValue(Mat& _image, const vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue){
 	if (!initialized) exit(1);
+	PROFILE_SCOPE("feature.mb_lbp");
+	PROFILE_COUNT("features_computed",n_features*n_scales*_sampleBox.size());
 	//int xMin, xMax, yMin, yMax;
     Mat IntegralImage;
     integral(_image, IntegralImage, CV_32F);
@@ -51,22 +60,18 @@ void MultiScaleBlockLBP::getFeatureValue(Mat& _image, vector<Rect> _sampleBox, b
 		//multiScaleBlock_Image( auxSubImage );
 		//vector<float> hist = multiScaleBlock_Mapping();
 		//for (unsigned int i = 0; i < hist.size(); ++i) cout << hist.at(i) << endl;		
-        if(_isPositiveBox){
-	        for (unsigned int i = 0; i < hist.size(); ++i){
-	        	sampleFeatureValue(k,i) = hist[i];
-	        }
-	    }else{
-	    	for (unsigned int i = 0; i < hist.size(); ++i){
-	        	negativeFeatureValue(k,i) = hist[i];
-	        }
-	    }
+        for (unsigned int i = 0; i < hist.size(); ++i){
+        	_featureValue(k,i) = hist[i];
+        }
 	}
 }
 
+int MultiScaleBlockLBP::getFeatureSize(){
+	return n_features*n_scales;
+}
+
 void MultiScaleBlockLBP::init(Mat& _image, vector<Rect> _sampleBox){
 	if (!initialized) exit(1);
-	sampleFeatureValue = MatrixXd(_sampleBox.size(),n_features*n_scales);
-    negativeFeatureValue = MatrixXd(_sampleBox.size(),n_features*n_scales);
     getFeatureValue(_image, _sampleBox, true);
 }
 
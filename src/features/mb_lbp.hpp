@@ -14,6 +14,7 @@
 #include <math.h>
 #include <bitset>
 #include <algorithm>
+#include "../utils/real.hpp"
  
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
@@ -30,11 +31,13 @@ public:
     MultiScaleBlockLBP();
     MultiScaleBlockLBP(int _p_blocks, int _n_features, int _slider, bool _copy_border, bool _multiscale = false, int _multiscale_slider = 3, int _n_scales = 1);
     void init(Mat& _image, vector<Rect> _sampleBox);
+    int getFeatureSize();
     void getFeatureValue(Mat& _image, vector<Rect> _sampleBox, bool _isPositiveBox);
+    void getFeatureValue(Mat& _image, const vector<Rect>& _sampleBox, Ref<MatrixXr> _featureValue);
     int multiScaleBlock_LBP(Mat& d_img, int y, int x);
     void multiScaleBlock_Image(Mat& d_img);
     vector<float> multiScaleBlock_Mapping();
-    MatrixXd sampleFeatureValue, negativeFeatureValue;
+    MatrixXr sampleFeatureValue, negativeFeatureValue;
 
 private:
     double Integrate(Mat& d_img, int r0, int c0, int r1, int c1);
@@ -16,6 +16,8 @@ class Problem {
   typedef Scalar_ Scalar;
   using TVector   = Eigen::Matrix<Scalar, Dim, 1>;
   using THessian  = Eigen::Matrix<Scalar, Dim, Dim>;
+  using TMatrix   = Eigen::Matrix<Scalar, Dim, Eigen::Dynamic>;
+  using TValues   = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
   using TCriteria = Criteria<Scalar>;
   using TIndex = typename TVector::Index;
 
@@ -45,6 +47,52 @@ class Problem {
   Scalar operator()(const  TVector &x) {
     return value(x);
   }
+
+  /**
+   * @brief whether value() and gradient() may run concurrently
+   * @details the batched and finite-difference fallbacks spread their
+   * evaluations over OpenMP threads; override and return false when the
+   * objective keeps mutable state
+   */
+  virtual bool threadSafe() const {
+    return true;
+  }
+
+  /**
+   * @brief objective values of a batch of points
+   * @details every column of X is one point; override with a vectorized
+   * expression (e.g. one matrix-matrix product) when the objective allows it
+   *
+   * @param X points, one per column
+   * @param f values, resized to X.cols()
+   */
+  virtual void valueBatch(const TMatrix &X, TValues &f) {
+    const int N = X.cols();
+    f.resize(N);
+    #pragma omp parallel for schedule(dynamic) if(threadSafe())
+    for (int k = 0; k < N; ++k) {
+      TVector xk = X.col(k);
+      f[k] = value(xk);
+    }
+  }
+
+  /**
+   * @brief gradients of a batch of points
+   *
+   * @param X points, one per column
+   * @param grads gradients, one per column
+   */
+  virtual void gradientBatch(const TMatrix &X, TMatrix &grads) {
+    const int N = X.cols();
+    grads.resize(X.rows(), N);
+    #pragma omp parallel for schedule(dynamic) if(threadSafe())
+    for (int k = 0; k < N; ++k) {
+      TVector xk = X.col(k);
+      TVector gk(X.rows());
+      gradient(xk, gk);
+      grads.col(k) = gk;
+    }
+  }
   /**
    * @brief returns gradient in x as reference parameter
    * @details should be overwritten by symbolic gradient
@@ -72,7 +120,7 @@ class Problem {
     gradient(x, actual_grad);
     finiteGradient(x, expected_grad, accuracy);
     for (TIndex d = 0; d < D; ++d) {
-      Scalar scale = std::max((std::max(fabs(actual_grad[d]), fabs(expected_grad[d]))), 1.);
+      Scalar scale = std::max((std::max(fabs(actual_grad[d]), fabs(expected_grad[d]))), Scalar(1.));
       if(fabs(actual_grad[d]-expected_grad[d])>1e-2 * scale)
         return false;
     }
@@ -109,49 +157,62 @@ class Problem {
     static const std::array<Scalar, 4> dd = {2, 12, 60, 840};
 
     grad.resize(x.rows());
-    TVector& xx = const_cast<TVector&>(x);
 
     const int innerSteps = 2*(accuracy+1);
     const Scalar ddVal = dd[accuracy]*eps;
+    const int D = x.rows();
 
-    for (TIndex d = 0; d < x.rows(); d++) {
-      grad[d] = 0;
-      for (int s = 0; s < innerSteps; ++s)
-      {
-        Scalar tmp = xx[d];
-        xx[d] += coeff2[accuracy][s]*eps;
-        grad[d] += coeff[accuracy][s]*value(xx);
-        xx[d] = tmp;
+    // every thread perturbs its own copy of x
+    #pragma omp parallel if(threadSafe())
+    {
+      TVector xx = x;
+      #pragma omp for schedule(dynamic)
+      for (int d = 0; d < D; d++) {
+        Scalar g = 0;
+        for (int s = 0; s < innerSteps; ++s)
+        {
+          Scalar tmp = xx[d];
+          xx[d] += coeff2[accuracy][s]*eps;
+          g += coeff[accuracy][s]*value(xx);
+          xx[d] = tmp;
+        }
+        grad[d] = g / ddVal;
       }
-      grad[d] /= ddVal;
     }
   }
 
   void finiteHessian(const TVector &x, THessian &hessian, int accuracy = 0) {
     const Scalar eps = std::numeric_limits<Scalar>::epsilon()*10e7;
+    const int D = x.rows();
 
-    hessian.resize(x.rows(), x.rows());
-    TVector& xx = const_cast<TVector&>(x);
+    hessian.resize(D, D);
 
     if(accuracy == 0) {
-      for (TIndex i = 0; i < x.rows(); i++) {
-        for (TIndex j = 0; j < x.rows(); j++) {
-          Scalar tmpi = xx[i];
-          Scalar tmpj = xx[j];
-
-          Scalar f4 = value(xx);
+      // f(x+ei+ej) - f(x+ei) - f(x+ej) + f(x): the single steps are shared by
+      // all entries and the stencil is symmetric, so only the upper triangle
+      // needs its own evaluation, D(D+1)/2 + D + 1 calls instead of 4 D^2
+      const Scalar f0 = value(x);
+      TValues fi(D);
+      #pragma omp parallel if(threadSafe())
+      {
+        TVector xx = x;
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < D; i++) {
           xx[i] += eps;
-          xx[j] += eps;
-          Scalar f1 = value(xx);
-          xx[j] -= eps;
-          Scalar f2 = value(xx);
-          xx[j] += eps;
-          xx[i] -= eps;
-          Scalar f3 = value(xx);
-          hessian(i, j) = (f1 - f2 - f3 + f4) / (eps * eps);
-
-          xx[i] = tmpi;
-          xx[j] = tmpj;
+          fi[i] = value(xx);
+          xx[i] = x[i];
+        }
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < D; i++) {
+          for (int j = i; j < D; j++) {
+            xx[i] += eps;
+            xx[j] += eps;
+            Scalar fij = value(xx);
+            xx[i] = x[i];
+            xx[j] = x[j];
+            hessian(i, j) = (fij - fi[i] - fi[j] + f0) / (eps * eps);
+            hessian(j, i) = hessian(i, j);
+          }
         }
       }
     } else {
@@ -163,40 +224,47 @@ class Problem {
           44(f_{2,-2}+f_{-2,2}-f_{-2,-2}-f_{2,2})+\\
           74(f_{-1,-1}+f_{1,1}-f_{1,-1}-f_{-1,1})
         \end{matrix}\right] }
+        symmetric in i and j, so only the upper triangle is evaluated
       */
-      for (TIndex i = 0; i < x.rows(); i++) {
-        for (TIndex j = 0; j < x.rows(); j++) {
-          Scalar tmpi = xx[i];
-          Scalar tmpj = xx[j];
-
-          Scalar term_1 = 0;
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += -2*eps;  term_1 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += -1*eps;  term_1 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += 1*eps;   term_1 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += 2*eps;   term_1 += value(xx);
-
-          Scalar term_2 = 0;
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += -2*eps;  term_2 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += -1*eps;  term_2 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += 2*eps;   term_2 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += 1*eps;   term_2 += value(xx);
-
-          Scalar term_3 = 0;
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += -2*eps;  term_3 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += 2*eps;   term_3 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += -2*eps;  term_3 -= value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += 2*eps;   term_3 -= value(xx);
-
-          Scalar term_4 = 0;
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += -1*eps;  term_4 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += 1*eps;   term_4 += value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += -1*eps;  term_4 -= value(xx);
-          xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += 1*eps;   term_4 -= value(xx);
-
-          xx[i] = tmpi;
-          xx[j] = tmpj;
-
-          hessian(i, j) = (-63 * term_1+63 * term_2+44 * term_3+74 * term_4)/(600.0 * eps * eps);
+      #pragma omp parallel if(threadSafe())
+      {
+        TVector xx = x;
+        #pragma omp for schedule(dynamic)
+        for (int i = 0; i < D; i++) {
+          for (int j = i; j < D; j++) {
+            Scalar tmpi = xx[i];
+            Scalar tmpj = xx[j];
+
+            Scalar term_1 = 0;
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += -2*eps;  term_1 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += -1*eps;  term_1 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += 1*eps;   term_1 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += 2*eps;   term_1 += value(xx);
+
+            Scalar term_2 = 0;
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += -2*eps;  term_2 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += -1*eps;  term_2 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += 2*eps;   term_2 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += 1*eps;   term_2 += value(xx);
+
+            Scalar term_3 = 0;
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += -2*eps;  term_3 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += 2*eps;   term_3 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -2*eps; xx[j] += -2*eps;  term_3 -= value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 2*eps;  xx[j] += 2*eps;   term_3 -= value(xx);
+
+            Scalar term_4 = 0;
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += -1*eps;  term_4 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += 1*eps;   term_4 += value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += 1*eps;  xx[j] += -1*eps;  term_4 -= value(xx);
+            xx[i] = tmpi; xx[j] = tmpj; xx[i] += -1*eps; xx[j] += 1*eps;   term_4 -= value(xx);
+
+            xx[i] = tmpi;
+            xx[j] = tmpj;
+
+            hessian(i, j) = (-63 * term_1+63 * term_2+44 * term_3+74 * term_4)/(600.0 * eps * eps);
+            hessian(j, i) = hessian(i, j);
+          }
         }
       }
     }
@@ -8,6 +8,18 @@
 
 namespace cppoptlib {
 
+/**
+ * @brief adapted search distribution of CMA-ES, enough to continue a run
+ * where it stopped; B and D are recomputed from C
+ */
+template<typename Scalar, int Dim = Eigen::Dynamic>
+struct CMAesState {
+    Scalar sigma;
+    Eigen::Matrix<Scalar, Dim, 1> xmean, pc, ps, gamma;
+    Eigen::Matrix<Scalar, Dim, Dim> C;
+    size_t iterations;
+};
+
 /**
  * @brief Covariance Matrix Adaptation
  */
@@ -21,10 +33,13 @@ public:
     using typename Super::TCriteria;
     using TMatrix = Eigen::Matrix<Scalar, TProblem::Dim, Eigen::Dynamic>;
     using TVarVector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+    using TState = CMAesState<Scalar, TProblem::Dim>;
 
 protected:
     std::mt19937 gen;
     Scalar m_stepSize;
+    TState m_state;
+    bool m_resume;
 
     /*
      * @brief Create a vector sampled from a normal distribution
@@ -59,6 +74,7 @@ protected:
 public:
     CMAesBSolver() : gen((std::random_device())()) {
         m_stepSize = 0.5;
+        m_resume = false;
 
         // Set some sensible defaults for the stop criteria
         Super::m_stop.iterations = 1e5;
@@ -68,6 +84,20 @@ public:
         Super::m_stop.fDelta = 1e-9;
     }
 
+    /**
+    * @brief state after the last completed iteration, updated before the
+    * problem's callback so that it can be checkpointed there
+    */
+    const TState &state() const { return m_state; }
+
+    /**
+    * @brief the next minimize() continues from s instead of starting afresh
+    */
+    void resume(const TState &s) {
+        m_state = s;
+        m_resume = true;
+    }
+
     /**
     * @brief minimize
     * @details [long description]
@@ -96,9 +126,9 @@ public:
 
         TVector pc = TVector::Zero(n);
         TVector ps = TVector::Zero(n);
-        THessian B = THessian::Identity();
-        THessian D = THessian::Identity();
-        THessian C = THessian::Zero();
+        THessian B = THessian::Identity(n, n);
+        THessian D = THessian::Identity(n, n);
+        THessian C = THessian::Zero(n, n);
         C.diagonal() = (objFunc.upperBound() - objFunc.lowerBound()) / 2;
         Eigen::SelfAdjointEigenSolver<THessian> eigenSolver(C);
         B = eigenSolver.eigenvectors();
@@ -109,15 +139,32 @@ public:
         TVector zmean = TVector::Zero(n);
         TMatrix arz(n, la);
         TMatrix arx(n, la);
+        TMatrix arx_feasible(n, la);
         TVarVector costs(la);
+        TVarVector penalties(la);
         Scalar prevCost = objFunc.value(x0);
         // Constraint handling
-        TVector gamma = TVector::Ones();
+        TVector gamma = TVector::Ones(n);
 
         // CMA-ES Main Loop
         int eigen_last_eval = 0;
         int eigen_next_eval = std::max<Scalar>(1, 1/(10*n*(c1+cmu)));
         this->m_current.reset();
+        if (m_resume) {
+            sigma = m_state.sigma;
+            xmean = m_state.xmean;
+            x0 = xmean;
+            pc = m_state.pc;
+            ps = m_state.ps;
+            gamma = m_state.gamma;
+            C = m_state.C;
+            Eigen::SelfAdjointEigenSolver<THessian> resumeSolver(C);
+            B = resumeSolver.eigenvectors();
+            D.diagonal() = resumeSolver.eigenvalues().array().sqrt();
+            this->m_current.iterations = m_state.iterations;
+            eigen_last_eval = m_state.iterations;
+            m_resume = false;
+        }
         if (Super::m_debug >= DebugLevel::Low) {
             std::cout << "CMA-ES Initial Config" << std::endl;
             std::cout << "n " << n << " la " << la << " mu " << mu << " mu_eff " << mu_eff << " sigma " << sigma << std::endl;
@@ -129,12 +176,15 @@ public:
                       << " cond " << this->m_current.condition << " xmean " << x0.transpose() << std::endl;
         }
         do {
+            // draw and clip the whole population, then score the feasible
+            // points in one batched call (parallel over candidates unless the
+            // problem overrides valueBatch)
+            const Scalar eta_sum = C.diagonal().array().log().sum()/n;
             for (int k = 0; k < la; ++k) {
               arz.col(k) = normDist(n);
               TVector xk = xmean + sigma * B*D*arz.col(k);
               arx.col(k) = xk;
               Scalar penalty = 0;
-              const Scalar eta_sum = C.diagonal().array().log().sum()/n;
               for (int d = 0; d < n; d++) {
                   Scalar dist = 0;
                   const Scalar eta = exp(0.9 * (log(C.coeffRef(d, d) - eta_sum)));
@@ -147,8 +197,11 @@ public:
                   }
                   penalty += (dist*dist) / eta;
               }
-              costs[k] = objFunc(xk) + penalty/n;
+              arx_feasible.col(k) = xk;
+              penalties[k] = penalty/n;
             }
+            objFunc.valueBatch(arx_feasible, costs);
+            costs += penalties;
 
             if (Super::m_debug >= DebugLevel::High) {
                 std::cout << "arz" << std::endl << arz << std::endl;
@@ -212,6 +265,13 @@ public:
                 }
             }
             Super::m_status = checkConvergence(this->m_stop, this->m_current);
+            m_state.sigma = sigma;
+            m_state.xmean = xmean;
+            m_state.pc = pc;
+            m_state.ps = ps;
+            m_state.gamma = gamma;
+            m_state.C = C;
+            m_state.iterations = this->m_current.iterations;
         } while (objFunc.callback(this->m_current, x0) && (this->m_status == Status::Continue));
         // Return the best evaluated solution
         x0 = xmean;
@@ -126,11 +126,14 @@ public:
                       << " cond " << this->m_current.condition << " xmean " << x0.transpose() << std::endl;
         }
         do {
+            // draw the whole population, then score it in one batched call
+            // (parallel over candidates unless the problem overrides valueBatch)
             for (int k = 0; k < la; ++k) {
               arz.col(k) = normDist(n);
-              arx.col(k) = xmean + sigma * B*D*arz.col(k);
-              costs[k] = objFunc(arx.col(k));
             }
+            arx.noalias() = (sigma * B*D) * arz;
+            arx.colwise() += xmean;
+            objFunc.valueBatch(arx, costs);
             if (Super::m_debug >= DebugLevel::High) {
                 std::cout << "arz" << std::endl << arz << std::endl;
                 std::cout << "arx" << std::endl << arx << std::endl;
@@ -1,6 +1,7 @@
 // Author: Diego Vergara
 #include "adaboost.hpp"
-#include "../utils/c_utils.hpp"
+#include "../utils/profiler.hpp"
+#include <limits>
 
 Adaboost::Adaboost()
 {
@@ -11,197 +12,142 @@ Adaboost::Adaboost(string _algorithm, int _n_estimators, double _alpha, double _
 {
     algorithm = _algorithm;
     n_estimators = _n_estimators;
+    n_fitted = 0;
     M_alpha = _alpha;
     learning_rate = _learning_rate;
     initialized=true;
 }
 
 
-double Adaboost::boost_discrete(VectorXd &w, int iteration, VectorXd &errors, vector<GaussianNaiveBayes> &classifiers){
-  
-
-  VectorXi predicted_labels;
-  VectorXd index = VectorXd::Zero(n_data);
-  ///////////////////////////////
-  //MultinomialNaiveBayes naive_bayes(*getdata(),*getlabels());
-  //naive_bayes.fit(M_alpha, w);
-  //predicted_labels=naive_bayes.test(*getdata());
-
-  GaussianNaiveBayes naive_bayes(*getdata(),*getlabels());
-  naive_bayes.fit(w);
-  predicted_labels=naive_bayes.test(*getdata());
-
-  ///////////////////////////////
-  classifiers.push_back(naive_bayes);
-  for (int i = 0; i < predicted_labels.rows(); ++i) index(i) = ((predicted_labels(i) == (*getlabels())(i)) ? 0: 1);
-  double e = (w.cwiseProduct(index)).colwise().sum()*(w.colwise().sum()).inverse();
+double Adaboost::boost_discrete(const Ref<const MatrixXr> &X, const VectorXi &Y, VectorXr &w, int iteration, VectorXr &errors){
+  WeightedGaussianNaiveBayes naive_bayes;
+  naive_bayes.fit(X, Y, w);
+  VectorXi predicted_labels = naive_bayes.test(X);
+  VectorXr index = (predicted_labels.array() != Y.array()).cast<real_t>();
+  double e = w.dot(index)/w.sum();
   if (e <= 0.0){
-    cout << "e negativo" << endl;
-    w = VectorXd::Zero(n_data);
+    // perfect fit, boosting stops; its vote follows the same formula as the
+    // others with the error clipped, as SAMME.R clips the probabilities
+    classifiers.push_back(naive_bayes);
     errors(iteration) = 0.0;
-    return -1.0;
-  }  
-
+    double e_clipped = std::numeric_limits<real_t>::epsilon();
+    return learning_rate * (log((1.0-e_clipped) / e_clipped) + log(n_classes-1.0));
+  }
   if (e >= 1.0 - (1.0 / n_classes)){
-    if (iteration == 0) cout << "Critico: Error en primera Iteracion" << endl;
-    cout << "e muy grande" << endl;
-    w = VectorXd::Zero(n_data);
+    // no better than chance, the learner is dropped and boosting stops
+    if (iteration == 0) cout << "Error: first weak learner no better than chance" << endl;
+    w = VectorXr::Zero(w.size());
     errors(iteration) = 0.0;
     return 0.0;
   }
+  classifiers.push_back(naive_bayes);
   double alpha = learning_rate * (log((1.0-e) / e) + log(n_classes-1.0)); 
-  for (int i = 0; i < n_data; ++i) index(i) *= (((w(i) > 0) or (alpha < 0)) ? 1: 0); //
+  for (int i = 0; i < w.size(); ++i) index(i) *= (((w(i) > 0) or (alpha < 0)) ? 1: 0);
   if (iteration != (n_estimators-1)) w = w.array() * ((index*alpha).array().exp());
-
-  
   errors(iteration) = e;
-  
   return alpha;
 }
 
-double Adaboost::boost_real(VectorXd &w, int iteration, VectorXd &errors, vector<GaussianNaiveBayes> &classifiers){
-  
-
-  VectorXi predicted_labels(n_data);
-  VectorXd index(n_data);
-  VectorXd alpha(n_data);
-  MatrixXd proba;
-  
-  ///////////////////////////////
-  //MultinomialNaiveBayes naive_bayes(*getdata(),*getlabels());
-  //naive_bayes.fit(M_alpha, w);
-  //proba=naive_bayes.get_proba(*getdata());
-
-  GaussianNaiveBayes naive_bayes(*getdata(),*getlabels());
-  naive_bayes.fit(w);
-  proba = naive_bayes.get_proba(*getdata());
-
-  MatrixXf::Index   maxIndex[proba.rows()];
-  for (int j =0; j< proba.rows(); ++j){
-    proba.row(j).maxCoeff(&maxIndex[j]);
-    predicted_labels(j) = maxIndex[j];
-   }
-  //predicted_labels=naive_bayes.test(*getdata());
-  ///////////////////////////////
+double Adaboost::boost_real(const Ref<const MatrixXr> &X, const VectorXi &Y, VectorXr &w, int iteration, VectorXr &errors){
+  WeightedGaussianNaiveBayes naive_bayes;
+  naive_bayes.fit(X, Y, w);
+  // log probabilities clipped at log(eps), as SAMME.R clips the probabilities
+  MatrixXr log_proba = naive_bayes.get_proba(X).cwiseMax(log(std::numeric_limits<real_t>::epsilon()));
   classifiers.push_back(naive_bayes);
-
-  for (int i = 0; i < predicted_labels.rows(); ++i) index(i) = ((predicted_labels(i) == (*getlabels())(i)) ? 0: 1);
-  double e = (w.cwiseProduct(index)).colwise().sum()*(w.colwise().sum()).inverse();
-
+  VectorXi predicted_labels(X.rows());
+  for (int j = 0; j < log_proba.rows(); ++j) log_proba.row(j).maxCoeff(&predicted_labels(j));
+  VectorXr index = (predicted_labels.array() != Y.array()).cast<real_t>();
+  double e = w.dot(index)/w.sum();
   if (e <= 0.0){
-    cout << "e negativo" << endl;
-    w = VectorXd::Zero(n_data);
     errors(iteration) = 0.0;
-    return -1.0;
-  }  
-
-  MatrixXd y_coding = MatrixXd::Ones(n_data, n_classes)*(-1. / (n_classes -1.));
-  for (int i = 0; i < n_data; ++i) y_coding(i ,(*getlabels())(i)) = 1.0; // ojo indices
-  
-  alpha = (-1. * learning_rate * (((n_classes -1.) / n_classes) * ((y_coding.array().cwiseProduct(proba.array())).rowwise().sum())));
-
-  for (int i = 0; i < n_data; ++i) index(i) = (((w(i) > 0) or (alpha(i) < 0)) ? 1: 0);
+    return 1.0;
+  }
+  // y_coding is 1 for the true class and -1/(K-1) elsewhere, only its row
+  // sums against log_proba are needed
+  VectorXr coded(X.rows());
+  for (int i = 0; i < X.rows(); ++i){
+    coded(i) = log_proba(i, Y(i)) - (log_proba.row(i).sum() - log_proba(i, Y(i)))/(n_classes - 1.);
+  }
+  VectorXr alpha = -1. * learning_rate * ((n_classes - 1.) / n_classes) * coded;
+  for (int i = 0; i < w.size(); ++i) index(i) = (((w(i) > 0) or (alpha(i) < 0)) ? 1: 0);
   if (iteration != (n_estimators-1)) w = w.array() * ((alpha.array()*index.array()).exp());
-  
-
-  
   errors(iteration) = e;
-  
   return 1.0;
 }
 
-void Adaboost::fit(MatrixXd &data, VectorXi &labels){
-  dX=&data;
-  lX=&labels;
-  C_utils utils;
-  classes  = utils.get_Classes(*(&labels));
-  n_classes = classes.size();
-  dim = getdata()->cols();
-  n_data = getdata()->rows();
-
-  if (initialized){
-
-    VectorXd w = VectorXd::Ones(n_data)/ n_data;
-    alphas = VectorXd::Zero(n_estimators);
-    VectorXd errors = VectorXd::Ones(n_estimators);
-
-    for (int i = 0; i < n_estimators; ++i){
-      cout << i << endl;
-
-      if (algorithm == "samme.r"){
-        alphas(i) = boost_real(w, i, errors, classifiers);  
-      }
-      else{
-        alphas(i) = boost_discrete(w, i, errors, classifiers);  
-      }   
-      
-      double w_sum = w.sum();
-
-      if ((w_sum <= 0) or ( errors(i) == 0.0)){
-        cout << "Break" << endl;
-        n_estimators = i+1;
-        break;
-      }
-
-      if (i < (n_estimators-1)) w /= w_sum; 
+void Adaboost::fit(const Ref<const MatrixXr> &data, const VectorXi &labels){
+  PROFILE_SCOPE("model.adaboost.fit");
+  if (!initialized){
+    cout << "Error: Model not initialized" << endl;
+    return;
+  }
+  n_classes = labels.maxCoeff()+1;
+  int n_data = data.rows();
+  classifiers.clear();
+  VectorXr w = VectorXr::Ones(n_data)/ n_data;
+  alphas = VectorXr::Zero(n_estimators);
+  VectorXr errors = VectorXr::Ones(n_estimators);
+  for (int i = 0; i < n_estimators; ++i){
+    if (algorithm == "samme.r"){
+      alphas(i) = boost_real(data, labels, w, i, errors);  
+    }
+    else{
+      alphas(i) = boost_discrete(data, labels, w, i, errors);  
+    }   
+    double w_sum = w.sum();
+    if ((w_sum <= 0) or ( errors(i) == 0.0)){
+      break;
     }
+    if (i < (n_estimators-1)) w /= w_sum; 
   }
+  n_fitted = classifiers.size();
+  alphas.conservativeResize(n_fitted);
 }
 
-MatrixXd Adaboost::get_proba(GaussianNaiveBayes classifier){
-  MatrixXd proba = classifier.get_proba(*gettest());
-  VectorXd temp(proba.rows());
-  temp = (1. / n_classes) * proba.rowwise().sum();
-  for (int i = 0; i < proba.rows(); ++i) for (int j = 0; j < proba.cols(); ++j) proba(i,j) -= temp(i);
-  return (n_classes - 1) * proba;
+int Adaboost::estimators() const
+{
+  return n_fitted;
 }
 
-VectorXi Adaboost::predict( MatrixXd &test){
-  dY=&test;
-  n_data_test = gettest()->rows();
-  MatrixXd pred = MatrixXd::Zero(n_data_test,n_classes);
-  VectorXi result = VectorXi::Zero(n_data_test);
-
+/* weighted vote of every class, SAMME.R adds (K-1)(log p - mean log p) of
+every learner, SAMME adds alpha to the predicted class; normalized by the sum
+of the learner weights */
+MatrixXr Adaboost::decision_function(const Ref<const MatrixXr> &test){
+  PROFILE_SCOPE("likelihood.adaboost");
+  MatrixXr pred = MatrixXr::Zero(test.rows(), n_classes);
+  if (n_fitted == 0){
+    cout << "Error: Model not initialized or not previously fitted" << endl;
+    return pred;
+  }
   if (algorithm == "samme.r"){
-    for (int i = 0; i < n_estimators; ++i) pred += get_proba(classifiers.at(i));
+    for (int m = 0; m < n_fitted; ++m){
+      MatrixXr log_proba = classifiers[m].get_proba(test).cwiseMax(log(std::numeric_limits<real_t>::epsilon()));
+      pred += log_proba;
+      pred.colwise() -= log_proba.rowwise().mean();
+    }
+    pred *= (n_classes - 1);
   }
   else{
-    VectorXi temp_Yhat;
-    for (int i = 0; i < n_estimators; ++i){
-      temp_Yhat= classifiers.at(i).test(*gettest());
-      for (int j =0; j< n_classes; ++j) for (int k = 0; k < temp_Yhat.rows(); ++k) pred(k,j) += ((temp_Yhat(k) != classes.at(j)) ? 1: 0)*alphas(i);
+    for (int m = 0; m < n_fitted; ++m){
+      VectorXi predicted = classifiers[m].test(test);
+      for (int k = 0; k < predicted.rows(); ++k) pred(k, predicted(k)) += alphas(m);
     }
   }
   pred /= alphas.sum();
-  if (n_classes == 2){
-    pred.col(0) *= -1;
-    pred.col(0) += pred.col(1);
-    for (int j =0; j< pred.rows(); ++j) result(j) = ((pred(j,0) > 0) ? classes.at(1): classes.at(0));
-  }
-  else{
-    MatrixXf::Index   maxIndex[pred.rows()];
-    for (int j =0; j< pred.rows(); ++j){
-      pred.row(j).maxCoeff(&maxIndex[j]);
-      result(j) = maxIndex[j];
-     }
-  }
-  //C_utils utils;
-  //utils.classification_Report(*gettestlabels(), result);
-  return result;
-}
-
-
- MatrixXd *Adaboost::getdata() 
-{
-    return dX;
+  return pred;
 }
 
- MatrixXd *Adaboost::gettest() 
-{
-    return dY;
+/* binary problems: decision of class 1 minus class 0, for SAMME.R the mean
+log odds of the learners */
+VectorXr Adaboost::log_odds(const Ref<const MatrixXr> &test){
+  MatrixXr pred = decision_function(test);
+  if (pred.cols() < 2) return VectorXr::Zero(test.rows());
+  return pred.col(1) - pred.col(0);
 }
 
- VectorXi *Adaboost::getlabels() 
-{
-    return lX;
+VectorXi Adaboost::predict(const Ref<const MatrixXr> &test){
+  MatrixXr pred = decision_function(test);
+  VectorXi result = VectorXi::Zero(test.rows());
+  for (int j = 0; j < pred.rows(); ++j) pred.row(j).maxCoeff(&result(j));
+  return result;
 }
@@ -5,8 +5,8 @@
 #include <iostream>
 #include <iomanip>  
 #include <Eigen/Dense>
-#include "multinomialnaivebayes.hpp"
 #include "weighted_gaussiannaivebayes.hpp"
+#include "../utils/real.hpp"
 #include <Eigen/Core>
 #include <string>
 #include <fstream>
@@ -17,32 +17,30 @@
 using namespace std;
 using namespace Eigen;
 
-
+/**
+ * SAMME ("samme") and SAMME.R ("samme.r") boosting of weighted Gaussian naive
+ * Bayes learners, labels 0..K-1. Rounds are sequential, each weak fit is a
+ * weighted-moments reduction; prediction sums all estimators in place.
+ */
 class Adaboost
 {
 public:
     Adaboost();
     Adaboost(string algorithm,int n_estimators, double alpha, double learning_rate);
-    void fit(MatrixXd &dX, VectorXi &lX);
-    VectorXi predict( MatrixXd &dY);
-    MatrixXd get_proba(GaussianNaiveBayes classifier);
-    double boost_discrete(VectorXd &w, int iteration, VectorXd &errors, vector<GaussianNaiveBayes> &classifiers);
-    double boost_real(VectorXd &w, int iteration, VectorXd &errors, vector<GaussianNaiveBayes> &classifiers);
-    MatrixXd *getdata();
-    MatrixXd *gettest();
-    VectorXi *getlabels(); 
+    void fit(const Ref<const MatrixXr> &X, const VectorXi &Y);
+    VectorXi predict(const Ref<const MatrixXr> &Xtest);
+    MatrixXr decision_function(const Ref<const MatrixXr> &Xtest);
+    VectorXr log_odds(const Ref<const MatrixXr> &Xtest);
+    int estimators() const;
 private:
-    int n_estimators, n_data, dim, n_data_test, n_classes;
+    double boost_discrete(const Ref<const MatrixXr> &X, const VectorXi &Y, VectorXr &w, int iteration, VectorXr &errors);
+    double boost_real(const Ref<const MatrixXr> &X, const VectorXi &Y, VectorXr &w, int iteration, VectorXr &errors);
+    int n_estimators, n_fitted, n_classes;
     string algorithm;
-    VectorXd alphas;
-    vector<GaussianNaiveBayes> classifiers;
-    //std::map<unsigned int,GaussianNaiveBayes, int> classifiers;
+    VectorXr alphas;
+    vector<WeightedGaussianNaiveBayes> classifiers;
     double M_alpha, learning_rate;
-    mt19937 generator;
-    MatrixXd *dX, *dY;
-    VectorXi *lX;
-    vector <int> classes;
     bool initialized;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -17,26 +17,39 @@ void dirichlet::setAlpha(VectorXd a){
     meanprecision();
 }
 
+/* Dirichlet-multinomial (Polya) log probability of one histogram. The lgamma
+of alpha and s come from the cache, and empty bins add exactly zero so they
+are skipped. */
 double dirichlet::log_likelihood(const Ref<const VectorXd>& counts){
-    VectorXd log_counts=VectorXd::Zero(counts.size());
-    VectorXd log_alpha=VectorXd::Zero(alpha.size());
-    VectorXd log_alpha_counts=VectorXd::Zero(alpha.size());
-    double csum=counts.sum();
+    double csum=0.0;
+    double loglike=0.0;
     for(int i=0;i<counts.size();i++){
-        log_counts[i]=lgamma(counts[i]+1);
-        log_alpha[i]=lgamma(alpha[i]);
-        log_alpha_counts[i]=lgamma(alpha[i]+counts[i]);
+        double c=counts[i];
+        if(c>0){
+            csum+=c;
+            loglike+=fastlgamma(alpha[i]+c)-log_gamma_alpha[i]-fastlgamma(c+1);
+        }
+    }
+    loglike+=fastlgamma(csum+1);
+    loglike+=log_gamma_s - fastlgamma(s + csum);
+    return loglike;
+}
+
+/* one histogram per row, e.g. the features of every particle */
+VectorXd dirichlet::batch_log_likelihood(const Ref<const MatrixXd>& counts){
+    VectorXd loglike(counts.rows());
+    #pragma omp parallel for
+    for(int i=0;i<counts.rows();i++){
+        loglike[i]=log_likelihood(counts.row(i).transpose());
     }
-    double loglike=0.0;
-    loglike+=lgamma(csum+1)-log_counts.sum();
-    loglike+=lgamma(s) - lgamma(s + csum);
-    loglike+=(log_alpha_counts-log_alpha).sum();
     return loglike;
 }
 
 void dirichlet::meanprecision(){
     s= alpha.sum();
     m= (1.0f/s)*alpha;
+    log_gamma_alpha=alpha.unaryExpr([](double a){ return fastlgamma(a); });
+    log_gamma_s=fastlgamma(s);
 }
 
 void dirichlet::dirichlet_moment_match(const Ref<const MatrixXd>& proportions, const Ref<const MatrixXd>& weigths){
@@ -65,7 +78,8 @@ void dirichlet::dirichlet_moment_match(const Ref<const MatrixXd>& proportions, c
     res=median((aok - m2ok).cwiseQuotient((m2ok - aok.cwiseProduct(aok))));
 
     alpha=a*res;
-    
+    meanprecision();
+
 }
 
 void dirichlet::dirichlet_moment_match(const Ref<const MatrixXd>& counts){
@@ -81,54 +95,79 @@ void dirichlet::dirichlet_moment_match(const Ref<const MatrixXd>& counts){
     dirichlet_moment_match(norm_counts,norm_sum);
 }
 
-void dirichlet::fit_fixedPoint(MatrixXd& counts,int maxIter,double tol){ //incomplete
-    int train=counts.rows();
+/* Histogram-of-counts sufficient statistics (Minka 2000). For integer counts
+sum_i psi(a+n_ik)-psi(a) = sum_c count_tail(c,k)/(a+c), where count_tail(c,k)
+is the number of rows whose count in bin k is above c, and total_tail holds
+the same for the row sums. The fits below only touch these tables, so an
+iteration costs O(D*max_count) however many rows were given. Counts are
+rounded to integers. */
+void dirichlet::count_statistics(const Ref<const MatrixXd>& counts)
+{
     int D=counts.cols();
-    int iter=0;
-    VectorXd old_alp ;
-    MatrixXd c;
-    VectorXd d;
-    double change = 2*tol;
-    //counts = counts[sum(counts.A, axis=1) > 0, :]
-    MatrixXd auxCounts = counts.rowwise().sum();
-    for(int i=0;i<auxCounts.rows();i++){
-         if(auxCounts(i,0)<0){
-            removeRow(auxCounts,i);
-            removeRow(counts,i);
-            i--;
-         }
+    VectorXd totals=counts.rowwise().sum().array().round();
+    int max_count=(int)round(counts.maxCoeff());
+    int max_total=(int)totals.maxCoeff();
+    count_tail=MatrixXd::Zero(max(max_count,1),D);
+    total_tail=VectorXd::Zero(max(max_total,1));
+    #pragma omp parallel for
+    for(int k=0;k<D;k++){
+        for(int i=0;i<counts.rows();i++){
+            int n=(int)round(counts(i,k));
+            if(n>0) count_tail(n-1,k)+=1.0;
+        }
+        for(int c=max_count-2;c>=0;c--) count_tail(c,k)+=count_tail(c+1,k);
+    }
+    for(int i=0;i<totals.size();i++){
+        if(totals(i)>0) total_tail((int)totals(i)-1)+=1.0;
     }
+    for(int c=max_total-2;c>=0;c--) total_tail(c)+=total_tail(c+1);
+}
+
+/* sum_i psi(a+n_i)-psi(a), the tail is non-increasing so the first empty
+count ends the sum */
+static double digamma_tail_sum(double a, const Ref<const VectorXd>& tail){
+    double sum=0.0;
+    for(int c=0;c<tail.size() && tail(c)>0;c++) sum+=tail(c)/(a+c);
+    return sum;
+}
 
-    //alpha = array(dirichlet_moment_match(counts)).flatten()
+/* sum_i psi'(a+n_i)-psi'(a) */
+static double trigamma_tail_sum(double a, const Ref<const VectorXd>& tail){
+    double sum=0.0;
+    for(int c=0;c<tail.size() && tail(c)>0;c++) sum-=tail(c)/((a+c)*(a+c));
+    return sum;
+}
+
+/* Minka's fixed point alpha_k <- alpha_k sum_i[psi(n_ik+alpha_k)-psi(alpha_k)] / sum_i[psi(n_i+s)-psi(s)],
+started from the moment match */
+void dirichlet::fit_fixedPoint(MatrixXd& counts,int maxIter,double tol){
+    removeNoTrials(counts);
     dirichlet_moment_match(counts);
-    c = MatrixXd::Zero(train,D);
-    d = VectorXd::Zero(train);
-
-    while(change > tol && iter < maxIter)
-    {
-        old_alp=alpha;
-        for (int i=0;i<train;i++){
-            c.row(i)=psi(counts.row(i)+alpha.transpose())-psi(alpha.transpose());
-            d[i]= psi(counts.row(i).sum()+alpha.sum())-psi(alpha.sum());
+    count_statistics(counts);
+    double change = 2*tol;
+    for(int iter=0;iter<maxIter && change>tol;iter++){
+        VectorXd old_alpha=alpha;
+        double denominator=digamma_tail_sum(old_alpha.sum(),total_tail);
+        #pragma omp parallel for
+        for(int k=0;k<alpha.size();k++){
+            alpha[k]=old_alpha[k]*digamma_tail_sum(old_alpha[k],count_tail.col(k))/denominator;
         }
-        auxCounts=(c.colwise().sum())*(1.0/d.sum());
-        alpha=alpha.cwiseProduct(auxCounts.transpose());
-        change = (alpha-old_alp).cwiseAbs().maxCoeff();
-        iter++;
+        change = (alpha-old_alpha).cwiseAbs().maxCoeff();
     }
-    
+    meanprecision();
 }
 
-void dirichlet::polya_fit_m(MatrixXd& counts,double tol)
+void dirichlet::polya_fit_m(double tol)
 {
     meanprecision();
     VectorXd old_m,a;
     for (int i=0;i<20;i++){
         old_m=m;
         a=s*m;
-        for(int j=0;j<counts.cols();j++)
+        #pragma omp parallel for
+        for(int j=0;j<count_tail.cols();j++)
         {
-            m(j)= (a(j)*di_pochhammer(a(j),counts.col(j))).sum();
+            m(j)= a(j)*digamma_tail_sum(a(j),count_tail.col(j));
         }
         m/=(m.sum());
         if ((m-old_m).cwiseAbs().maxCoeff() < tol){
@@ -139,24 +178,29 @@ void dirichlet::polya_fit_m(MatrixXd& counts,double tol)
 }
 
 
-void dirichlet::s_derivatives(MatrixXd& counts, double *g,double *h)
+void dirichlet::s_derivatives(double *g,double *h)
 {
     meanprecision();
-    *g=-1.0*(di_pochhammer(s,counts.rowwise().sum()).sum());
-    *h=-1.0*(tri_pochhammer(s,counts.rowwise().sum()).sum());
-    
-    for(int k=0;k<counts.cols();k++){
-        *g+=m[k]* di_pochhammer(alpha[k],counts.col(k)).sum();
-        *h+=std::pow(m[k],2.0)*tri_pochhammer(alpha[k],counts.col(k)).sum();
+    double _g=-1.0*digamma_tail_sum(s,total_tail);
+    double _h=-1.0*trigamma_tail_sum(s,total_tail);
+    #pragma omp parallel for reduction(+:_g,_h)
+    for(int k=0;k<count_tail.cols();k++){
+        _g+=m[k]*digamma_tail_sum(alpha[k],count_tail.col(k));
+        _h+=m[k]*m[k]*trigamma_tail_sum(alpha[k],count_tail.col(k));
     }
+    *g=_g;
+    *h=_h;
 }
-double dirichlet::stable_a2(MatrixXd& counts){
-    VectorXd scounts=counts.rowwise().sum();
-    double a,ak; 
+
+/* sum_i n_i(n_i-1)(2n_i-1)/6 = sum_c c^2 #(n_i>c) */
+double dirichlet::stable_a2(){
+    double a,ak;
     m= alpha*(1.0/alpha.sum());
-    a = (1.0/6.0)*(scounts*(scounts.array()-1).matrix()*(2*scounts.array()-1).matrix()).sum();
-    for(int k=0;k<counts.cols();k++){
-        ak = (1.0/6.0)*(counts.col(k)*(counts.col(k).array()-1).matrix()*(2*counts.col(k).array()-1).matrix()).sum();
+    a=0.0;
+    for(int c=1;c<total_tail.size();c++) a+=(double)c*c*total_tail(c);
+    for(int k=0;k<count_tail.cols();k++){
+        ak=0.0;
+        for(int c=1;c<count_tail.rows();c++) ak+=(double)c*c*count_tail(c,k);
         if(ak > 0){
             a-=ak/(m[k]*m[k]);
         }
@@ -164,15 +208,18 @@ double dirichlet::stable_a2(MatrixXd& counts){
     return a;
 }
 
-void dirichlet::polya_fit_s(MatrixXd& counts,double tol)
+void dirichlet::polya_fit_s(double tol)
 {
     double h,g,eps,c,a0,a1,a2,b;
     VectorXd old_alpha;
     meanprecision();
     eps= std::numeric_limits<double>::epsilon();
-    
+    // positive counts and positive row sums, i.e. #(n>0) of the tables
+    double positive_counts=count_tail.row(0).sum();
+    double positive_totals=total_tail(0);
+
     for(int iter=0;iter<10;iter++){
-        s_derivatives(counts,&g,&h);
+        s_derivatives(&g,&h);
         if (g > eps){
             c = g+s*h;  
             if(c >=0){
@@ -183,7 +230,7 @@ void dirichlet::polya_fit_s(MatrixXd& counts,double tol)
         } 
         if(g<-eps){
             
-            c = positives(counts)- positives(counts.rowwise().sum());
+            c = positive_counts - positive_totals;
             
             if(c >0){
                 a0 = s*s*h+c;
@@ -191,7 +238,7 @@ void dirichlet::polya_fit_s(MatrixXd& counts,double tol)
                 if( abs(2.0*g+h*s) > eps ){
                     a2=s*s*s*(2.0*g+h*s);
                 }else{
-                    a2= stable_a2(counts);
+                    a2= stable_a2();
                 }
                 b= quad_root(a2,a1,a0);
                 s= 1/ ((1 / s) - (g / c) * std::pow((s + b)/b,2));
@@ -213,11 +260,13 @@ void dirichlet::fit_betabinom_minka_alternating(MatrixXd& counts, int maxiter, d
     double change = 2*tol;
     VectorXd alpha_old;
     dirichlet_moment_match(counts);
+    count_statistics(counts);
 
     for(int iter=0;iter<maxiter && change>tol;iter++){
         alpha_old=alpha;
-        polya_fit_m(counts,tol);
-        polya_fit_s(counts,tol);
+        polya_fit_m(tol);
+        polya_fit_s(tol);
         change = (alpha_old - alpha).cwiseAbs().maxCoeff();
     }
+    meanprecision();
 }
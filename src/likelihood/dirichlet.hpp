@@ -32,6 +32,7 @@ class dirichlet{
 		//methods
 		void meanprecision();
         double log_likelihood(const Ref<const VectorXd>&counts);
+        VectorXd batch_log_likelihood(const Ref<const MatrixXd>& counts);
 		void fit_fixedPoint(MatrixXd& counts,int maxIter,double tol);
 		void dirichlet_moment_match(const Ref<const MatrixXd>& proportions, const Ref<const MatrixXd>& weigths);
         void dirichlet_moment_match(const Ref<const MatrixXd>& counts);
@@ -40,10 +41,15 @@ class dirichlet{
 		VectorXd alpha;
 	    VectorXd m;
 		double s;
-		void polya_fit_m(MatrixXd& counts,double tol);
-		void s_derivatives(MatrixXd& counts, double *g,double *h);
-		double stable_a2(MatrixXd& counts);
-		void polya_fit_s(MatrixXd& counts,double tol);		
+		VectorXd log_gamma_alpha; /** lgamma(alpha), refreshed with m and s */
+		double log_gamma_s;
+		MatrixXd count_tail; /** count_tail(c,k): rows with more than c counts in bin k */
+		VectorXd total_tail; /** total_tail(c): rows with more than c counts in total */
+		void count_statistics(const Ref<const MatrixXd>& counts);
+		void polya_fit_m(double tol);
+		void s_derivatives(double *g,double *h);
+		double stable_a2();
+		void polya_fit_s(double tol);		
 };
 
 #endif
@@ -1,62 +1,124 @@
 //Author: Diego Vergara
 #include "hamiltonian_monte_carlo.hpp"
+#include "../utils/profiler.hpp"
 
 
 Hamiltonian_MC::Hamiltonian_MC(){
 	init = false;
+	gradient_evaluations = 0;
+	ess_per_gradient = 0.0;
+	n_samples = 0;
 }
 
 
-Hamiltonian_MC::Hamiltonian_MC(MatrixXd &_X, VectorXd &_Y, double _lambda){
+Hamiltonian_MC::Hamiltonian_MC(MatrixXr &_X, VectorXr &_Y, real_t _lambda){
 	lambda=_lambda;
 	X_train = &_X;
  	Y_train = &_Y;
 	dim = _X.cols();
     logistic_regression = LogisticRegression(_X, _Y, _lambda);
     init = true;
-    unsigned seed1 = std::chrono::system_clock::now().time_since_epoch().count();
-    generator.seed(seed1);
-
+	gradient_evaluations = 0;
+	ess_per_gradient = 0.0;
+	num_chains = 1;
+	step_size = 1e-2;
+	inv_metric = VectorXr::Ones(dim);
+	reset_mean();
 }
 
-void Hamiltonian_MC::run(int _iterations, double _step_size, int _num_step){
+void Hamiltonian_MC::run(int _iterations, real_t _step_size, int _num_step, int _num_chains){
+	PROFILE_SCOPE("model.hmc.run");
 	if (init)
 	{	
 		step_size = _step_size;
 		num_step = _num_step;
-		MatrixXd _weights(_iterations, dim);
-
-		//iterations = _iterations;
-		/*std::default_random_engine generator;
-  		std::normal_distribution<double> distribution(0.0,1.0);
-  		auto normal = [&] (double) {return distribution(generator);};
-		VectorXd initial_x = VectorXd::NullaryExpr(dim, normal);*/
-		VectorXd initial_x = VectorXd::Random(dim);
-		for (int i = 0; i < _iterations; ++i)
-		{	
+		num_chains = max(1, min(_num_chains, _iterations));
+		inv_metric = VectorXr::Ones(dim);
+		MatrixXr _weights(_iterations, dim);
 
-			_weights.row(i) = simulation(initial_x);
-			
+		// every draw is kept, so the chains start at the MAP instead of walking
+		// in from uniform[-1,1]; one column per chain, all chains advance together
+		VectorXr w_map(dim);
+		for (int i = 0; i < dim; ++i) w_map(i) = 2.0*generator.uniform()-1.0;
+		typedef LogisticRegressionWrapper<real_t> LogRegWrapper;
+		LogRegWrapper fun(&logistic_regression);
+		cppoptlib::Criteria<real_t> crit = cppoptlib::Criteria<real_t>::defaults();
+		crit.iterations = 100;
+		cppoptlib::LbfgsSolver<LogRegWrapper> solver;
+		solver.setStopCriteria(crit);
+		solver.minimize(fun, w_map);
+		MatrixXr x = w_map.replicate(1, num_chains);
+		MatrixXr gradient;
+		VectorXr potential = logistic_regression.batchLogPosterior(x, gradient);
+		for (int i = 0; i < _iterations; i += num_chains)
+		{	
+			simulation(x, potential, gradient);
+			int n_samples = min(num_chains, _iterations - i);
+			_weights.middleRows(i, n_samples) = x.leftCols(n_samples).transpose();
 		}
 		weights = _weights;
+		reset_mean();
+		accumulate_mean(weights.transpose());
 	}
 	else{
 		cout << "Error: No initialized function"<< endl;
 	}
 }
 
-VectorXd Hamiltonian_MC::predict(MatrixXd &_X_test){
-	VectorXd predict;
+void Hamiltonian_MC::run_incremental(int _iterations, int _num_step){
+	/*Short warm-started run after setData, cheap enough for every frame
+    Parameters
+    ----------
+    iterations : int
+        Number of new draws, spread over the chains
+    num_step : int
+        Leapfrog steps per transition, the step size and mass matrix of the
+        last run or run_nuts are reused
+    */
+	PROFILE_SCOPE("model.hmc.incremental");
+	if (init && n_samples > 0)
+	{
+		num_step = _num_step;
+		num_chains = max(1, min(num_chains, _iterations));
+		// every chain starts at the previous posterior mean
+		MatrixXr x = mean_weights.replicate(1, num_chains);
+		MatrixXr gradient;
+		VectorXr potential = logistic_regression.batchLogPosterior(x, gradient);
+		// the old posterior weighs at most as much as the new draws, so the
+		// mean tracks the data instead of averaging the whole sequence
+		n_samples = min(n_samples, (long)_iterations);
+		for (int i = 0; i < _iterations; i += num_chains)
+		{
+			simulation(x, potential, gradient);
+			accumulate_mean(x.leftCols(min(num_chains, _iterations - i)));
+		}
+	}
+	else{
+		cout << "Error: No initialized function or previous posterior"<< endl;
+	}
+}
+
+void Hamiltonian_MC::reset_mean(){
+	mean_weights = VectorXr::Zero(dim);
+	n_samples = 0;
+}
+
+void Hamiltonian_MC::accumulate_mean(const Ref<const MatrixXr> &samples){
+	// samples are columns; the logistic model always holds the current mean
+	for (int i = 0; i < samples.cols(); ++i)
+	{
+		n_samples++;
+		mean_weights += (samples.col(i) - mean_weights)/n_samples;
+	}
+	logistic_regression.setWeights(mean_weights);
+}
+
+VectorXr Hamiltonian_MC::predict(const Ref<const MatrixXr> &_X_test){
+	PROFILE_SCOPE("likelihood.hmc");
+	VectorXr predict;
 	if (init)
 	{	
-		VectorXd mean_weights;
-		//if(weights.rows()>0) {
-			mean_weights = weights.colwise().mean();
-		//}
-		//else {
-		//	mean_weights = VectorXd::Random(dim);
-		//}
-		logistic_regression.setWeights(mean_weights);
+		// weights were set to the running mean when the samples were drawn
 		predict = logistic_regression.predict(_X_test);
 		return predict;
 		
@@ -67,127 +129,334 @@ VectorXd Hamiltonian_MC::predict(MatrixXd &_X_test){
 	}
 }
 
-VectorXd Hamiltonian_MC::simulation(VectorXd &_initial_x){
-	/*Summary
+void Hamiltonian_MC::simulation(MatrixXr &_x, VectorXr &_potential, MatrixXr &_gradient){
+	/*One HMC transition for every chain
     Parameters
     ----------
-    initial_x : VectorXd
-        Initial sample x ~ p
-    step_size : double
-        Step-size in Hamiltonian simulation
-    num_steps : int
-        Number of steps to take in Hamiltonian simulation
-    log_posterior : object
-        Log posterior (unnormalized) for the target distribution
-    Returns
-    -------
-    sample : 
-        Sample ~ target distribution
+    x : MatrixXr
+        Current state, one column per chain, replaced by the new sample
+    potential : VectorXr
+        -log_posterior of every chain at x, kept in sync with x
+    gradient : MatrixXr
+        Gradient of the potential at x, kept in sync with x
     */
 
 	if (init)
 	{
+		MatrixXr v(dim, num_chains);
+		generator.fill_normal(v);
+		v = inv_metric.cwiseSqrt().cwiseInverse().asDiagonal()*v;
+		VectorXr orig = _potential + kinetic_energy(v);
+		MatrixXr x = _x;
+		MatrixXr gradient = _gradient;
+		VectorXr potential;
+		leap_Frog(x, v, gradient, potential);
+		VectorXr current = potential + kinetic_energy(v);
+		PROFILE_COUNT("gradient_evaluations",num_step*num_chains);
 
-  		VectorXd v0 = VectorXd::Zero(_initial_x.rows());
-  		VectorXd x(_initial_x.rows());
-  		VectorXd v(_initial_x.rows());
-  		leap_Frog(_initial_x, v0, x, v);
-		double orig = hamiltonian(_initial_x, v0);
-		double current = hamiltonian(x, v);
-		double p_accept = min(1.0, exp(orig - current));
-
-		normal_distribution<double> dnormal(0.0,1.0);
-		if (p_accept > dnormal(generator))
+		VectorXr log_uniform(num_chains);
+		for (int c = 0; c < num_chains; ++c) log_uniform(c) = log(generator.uniform());
+		int accepted = 0;
+		for (int c = 0; c < num_chains; ++c)
 		{
-			return x;
+			if (log_uniform(c) < orig(c) - current(c))
+			{
+				_x.col(c) = x.col(c);
+				_gradient.col(c) = gradient.col(c);
+				_potential(c) = potential(c);
+				accepted++;
+			}
 		}
-		else{
-			return _initial_x;
-		}
-
+		PROFILE_COUNT("hmc_accepted",accepted);
+		PROFILE_COUNT("hmc_proposals",num_chains);
 	}
 	else{
 		cout << "Error: No initialized function"<< endl;
-		return _initial_x;
 	}
 }
 
-void Hamiltonian_MC::leap_Frog(VectorXd &_x0, VectorXd &_v0, VectorXd &x, VectorXd &v){
+void Hamiltonian_MC::leap_Frog(MatrixXr &x, MatrixXr &v, MatrixXr &gradient, VectorXr &potential){
+	// x, v and gradient are dim x num_chains; every gradient is one batched
+	// X*W product (Eigen runs it over the OpenMP threads)
 	//Start by updating the velocity a half-step
-	// x(dim);
-	// v(dim);
-	RowVectorXd rowX(dim);
-	rowX << _x0.transpose();
-	v = _v0 - 0.5 * step_size * logistic_regression.gradient(rowX);
-	//Initalize x to be the first step
-	//RowVectorXd x= Map<RowVectorXd>(_x,dim);
-	x = _x0 + step_size * v;
-	rowX << x.transpose();
+	v.noalias() -= (0.5 * step_size) * gradient;
 	for (int i = 0; i < num_step; ++i)
 	{
-		//Compute gradient of the log-posterior with respect to x
-		VectorXd gradient = logistic_regression.gradient(rowX);
-		//Update velocity
-		v = v - step_size * gradient;
 		//Update x
-		x = x + step_size * v;
-		rowX << x.transpose();
+		x.noalias() += step_size * (inv_metric.asDiagonal() * v);
+		//Compute gradient of the log-posterior with respect to x, the potential
+		//of the final position comes out of the same product
+		if (i == num_step-1) potential = logistic_regression.batchLogPosterior(x, gradient);
+		else gradient = logistic_regression.batchGradient(x);
+		//Update velocity, the last one only for a half step
+		v.noalias() -= ((i == num_step-1) ? 0.5 * step_size : step_size) * gradient;
 	}
-	//Do a final update of the velocity for a half step
-	//return new proposal state
-	v = v -0.5 * step_size * logistic_regression.gradient(rowX);
-
 }
 
-double Hamiltonian_MC::hamiltonian(VectorXd &_position, VectorXd &_velocity){
-	/*Computes the Hamiltonian of the current position, velocity pair
-    H = U(x) + K(v)
-    U is the potential energy and is = -log_posterior(x)
-    Parameters
-    ----------
-    position : VectoXd
-        Position or state vector x (sample from the target distribution)
-    velocity : VectorXd
-        Auxiliary velocity variable
-    energy_function
-        Function from state to position to 'energy'
-         = -log_posterior
-    Returns
-    -------
-    hamitonian : double
+VectorXr Hamiltonian_MC::kinetic_energy(const MatrixXr &_velocity){
+	/*Kinetic energy of the current velocity under the diagonal mass matrix
+        (v^T M^-1 v) / 2, one value per chain
     */
 
-	RowVectorXd rowPosition(dim);
-	rowPosition << _position.transpose();
-	double energy_function = - logistic_regression.logPosterior(rowPosition);
-	return energy_function + kinetic_energy(_velocity);
+	return 0.5 * (inv_metric.asDiagonal() * _velocity.cwiseAbs2()).colwise().sum().transpose();
 }
 
-double Hamiltonian_MC::kinetic_energy(VectorXd &_velocity){
-	/*Kinetic energy of the current velocity (assuming a standard Gaussian)
-        (x dot x) / 2
+
+void Hamiltonian_MC::run_nuts(int _iterations, int _warmup, real_t _target_accept, int _max_depth){
+	/*No-U-Turn sampler (Hoffman & Gelman 2014, Algorithm 6)
     Parameters
     ----------
-    velocity : VectorXd
-        Vector of current velocity
-    Returns
-    -------
-    kinetic_energy : double
+    iterations : int
+        Number of posterior samples kept in weights
+    warmup : int
+        Iterations spent adapting the step size (dual averaging) and the
+        diagonal mass matrix, then discarded
+    target_accept : real_t
+        Target mean acceptance statistic for dual averaging
+    max_depth : int
+        Maximum tree depth, at most 2^max_depth leapfrog steps per sample
     */
+	PROFILE_SCOPE("model.hmc.nuts");
+	if (!init)
+	{
+		cout << "Error: No initialized function"<< endl;
+		return;
+	}
+	const real_t gamma = 0.05, t0 = 10.0, kappa = 0.75;
+	// mass matrix is estimated over the middle of warmup; the first part lets
+	// the chain reach the typical set, the last part re-adapts the step size
+	const int window_start = _warmup/4, window_end = (3*_warmup)/4;
+	gradient_evaluations = 0;
+	inv_metric = VectorXr::Ones(dim);
+	MatrixXr _weights(_iterations, dim);
+	VectorXr x(dim);
+	for (int i = 0; i < dim; ++i) x(i) = 2.0*generator.uniform()-1.0;
+	MatrixXr g_x;
+	real_t potential = logistic_regression.batchLogPosterior(x, g_x)(0);
+	VectorXr g = g_x;
+	gradient_evaluations++;
+
+	real_t epsilon = find_step_size(x, g, potential);
+	real_t mu = log(10.0*epsilon), log_epsilon_bar = 0.0, H_bar = 0.0;
+	int adapt_step = 0;
+	VectorXr window_mean = VectorXr::Zero(dim), window_m2 = VectorXr::Zero(dim);
+	int window_count = 0;
+
+	for (int m = 0; m < _warmup + _iterations; ++m)
+	{
+		VectorXr p(dim);
+		generator.fill_normal(p);
+		p = p.cwiseQuotient(inv_metric.cwiseSqrt());
+		real_t H0 = potential + momentum_energy(p);
+		real_t log_u = log(generator.uniform()) - H0;
+		VectorXr x_minus = x, x_plus = x, p_minus = p, p_plus = p, g_minus = g, g_plus = g;
+		int n = 1, depth = 0;
+		bool s = true;
+		nuts_tree tree;
+		real_t alpha = 0.0;
+		int n_alpha = 1;
+		while (s && depth < _max_depth)
+		{
+			int direction = (generator.uniform() < 0.5) ? -1 : 1;
+			if (direction == -1)
+			{
+				tree = build_tree(x_minus, p_minus, g_minus, log_u, direction, depth, epsilon, H0);
+				x_minus = tree.x_minus; p_minus = tree.p_minus; g_minus = tree.g_minus;
+			}
+			else
+			{
+				tree = build_tree(x_plus, p_plus, g_plus, log_u, direction, depth, epsilon, H0);
+				x_plus = tree.x_plus; p_plus = tree.p_plus; g_plus = tree.g_plus;
+			}
+			if (tree.s && generator.uniform() < (real_t)tree.n/n)
+			{
+				x = tree.x_proposal;
+				g = tree.g_proposal;
+				potential = tree.potential_proposal;
+			}
+			n += tree.n;
+			s = tree.s && no_u_turn(x_minus, x_plus, p_minus, p_plus);
+			alpha = tree.alpha;
+			n_alpha = max(tree.n_alpha, 1);
+			depth++;
+		}
+		if (m < _warmup)
+		{
+			// dual averaging (Hoffman & Gelman 2014, Algorithm 5)
+			adapt_step++;
+			real_t w = 1.0/(adapt_step + t0);
+			H_bar = (1.0 - w)*H_bar + w*(_target_accept - alpha/n_alpha);
+			real_t log_epsilon = mu - sqrt((real_t)adapt_step)/gamma*H_bar;
+			real_t eta = pow((real_t)adapt_step, -kappa);
+			log_epsilon_bar = eta*log_epsilon + (1.0 - eta)*log_epsilon_bar;
+			epsilon = exp(log_epsilon);
+			if (m >= window_start && m < window_end)
+			{
+				// Welford running variance of the warmup draws
+				window_count++;
+				VectorXr delta = x - window_mean;
+				window_mean += delta/window_count;
+				window_m2 += delta.cwiseProduct(x - window_mean);
+			}
+			if (m == window_end - 1 && window_count > 1)
+			{
+				// regularized towards the identity, as in Stan
+				real_t shrink = (real_t)window_count/(window_count + 5.0);
+				inv_metric = shrink*window_m2/(window_count - 1.0) + VectorXr::Constant(dim, 1e-3*(5.0/(window_count + 5.0)));
+				epsilon = find_step_size(x, g, potential);
+				mu = log(10.0*epsilon);
+				log_epsilon_bar = 0.0;
+				H_bar = 0.0;
+				adapt_step = 0;
+			}
+			if (m == _warmup - 1) epsilon = exp(log_epsilon_bar);
+		}
+		else
+		{
+			_weights.row(m - _warmup) = x.transpose();
+		}
+	}
+	weights = _weights;
+	step_size = epsilon;
+	reset_mean();
+	accumulate_mean(weights.transpose());
+	PROFILE_COUNT("gradient_evaluations",gradient_evaluations);
+	ess_per_gradient = effective_sample_size(weights)/gradient_evaluations;
+	PROFILE_GAUGE("hmc_ess_per_gradient",ess_per_gradient);
+}
 
-	return 0.5 * _velocity.adjoint()*_velocity;
+nuts_tree Hamiltonian_MC::build_tree(const VectorXr &x, const VectorXr &p, const VectorXr &g, real_t log_u, int direction, int depth, real_t epsilon, real_t H0){
+	nuts_tree tree;
+	if (depth == 0)
+	{
+		// base case, a single leapfrog step in the chosen direction
+		VectorXr x_new = x, p_new = p, g_new = g;
+		real_t potential = 0.0;
+		leapfrog_step(x_new, p_new, g_new, potential, direction*epsilon);
+		real_t H = potential + momentum_energy(p_new);
+		if (std::isnan(H)) H = std::numeric_limits<real_t>::infinity();
+		tree.x_minus = tree.x_plus = tree.x_proposal = x_new;
+		tree.p_minus = tree.p_plus = p_new;
+		tree.g_minus = tree.g_plus = tree.g_proposal = g_new;
+		tree.potential_proposal = potential;
+		tree.n = (log_u <= -H) ? 1 : 0;
+		tree.s = (log_u < 1000.0 - H);
+		tree.alpha = min((real_t)1.0, exp(H0 - H));
+		tree.n_alpha = 1;
+		return tree;
+	}
+	tree = build_tree(x, p, g, log_u, direction, depth - 1, epsilon, H0);
+	if (tree.s)
+	{
+		nuts_tree subtree;
+		if (direction == -1)
+		{
+			subtree = build_tree(tree.x_minus, tree.p_minus, tree.g_minus, log_u, direction, depth - 1, epsilon, H0);
+			tree.x_minus = subtree.x_minus; tree.p_minus = subtree.p_minus; tree.g_minus = subtree.g_minus;
+		}
+		else
+		{
+			subtree = build_tree(tree.x_plus, tree.p_plus, tree.g_plus, log_u, direction, depth - 1, epsilon, H0);
+			tree.x_plus = subtree.x_plus; tree.p_plus = subtree.p_plus; tree.g_plus = subtree.g_plus;
+		}
+		if (subtree.n > 0 && generator.uniform() < (real_t)subtree.n/(tree.n + subtree.n))
+		{
+			tree.x_proposal = subtree.x_proposal;
+			tree.g_proposal = subtree.g_proposal;
+			tree.potential_proposal = subtree.potential_proposal;
+		}
+		tree.alpha += subtree.alpha;
+		tree.n_alpha += subtree.n_alpha;
+		tree.n += subtree.n;
+		tree.s = subtree.s && no_u_turn(tree.x_minus, tree.x_plus, tree.p_minus, tree.p_plus);
+	}
+	return tree;
 }
 
+bool Hamiltonian_MC::no_u_turn(const VectorXr &x_minus, const VectorXr &x_plus, const VectorXr &p_minus, const VectorXr &p_plus){
+	VectorXr dx = x_plus - x_minus;
+	return dx.dot(inv_metric.cwiseProduct(p_minus)) >= 0 && dx.dot(inv_metric.cwiseProduct(p_plus)) >= 0;
+}
+
+void Hamiltonian_MC::leapfrog_step(VectorXr &x, VectorXr &p, VectorXr &g, real_t &potential, real_t epsilon){
+	p -= 0.5*epsilon*g;
+	x += epsilon*inv_metric.cwiseProduct(p);
+	// potential and gradient share one X*x product
+	MatrixXr g_x;
+	potential = logistic_regression.batchLogPosterior(x, g_x)(0);
+	g = g_x;
+	p -= 0.5*epsilon*g;
+	gradient_evaluations++;
+}
+
+real_t Hamiltonian_MC::momentum_energy(const VectorXr &p){
+	// kinetic energy under the diagonal mass matrix M = diag(1/inv_metric)
+	return 0.5*p.cwiseProduct(inv_metric).dot(p);
+}
+
+real_t Hamiltonian_MC::find_step_size(const VectorXr &x, const VectorXr &g, real_t potential){
+	// heuristic initial step size (Hoffman & Gelman 2014, Algorithm 4)
+	real_t epsilon = 1.0;
+	VectorXr p(dim);
+	generator.fill_normal(p);
+	p = p.cwiseQuotient(inv_metric.cwiseSqrt());
+	real_t H0 = potential + momentum_energy(p);
+	VectorXr x_new = x, p_new = p, g_new = g;
+	real_t new_potential = 0.0;
+	leapfrog_step(x_new, p_new, g_new, new_potential, epsilon);
+	real_t log_ratio = H0 - new_potential - momentum_energy(p_new);
+	if (std::isnan(log_ratio)) log_ratio = -std::numeric_limits<real_t>::infinity();
+	real_t a = (log_ratio > log(0.5)) ? 1.0 : -1.0;
+	for (int i = 0; i < 50 && a*log_ratio > -a*log(2.0); ++i)
+	{
+		epsilon *= pow(2.0, a);
+		x_new = x; p_new = p; g_new = g;
+		leapfrog_step(x_new, p_new, g_new, new_potential, epsilon);
+		log_ratio = H0 - new_potential - momentum_energy(p_new);
+		if (std::isnan(log_ratio)) log_ratio = -std::numeric_limits<real_t>::infinity();
+	}
+	return epsilon;
+}
+
+real_t Hamiltonian_MC::effective_sample_size(const MatrixXr &samples){
+	// Geyer's initial positive sequence per coordinate, the smallest ESS is reported
+	int n = samples.rows();
+	if (n < 4) return n;
+	real_t min_ess = n;
+	#pragma omp parallel for reduction(min:min_ess)
+	for (int d = 0; d < samples.cols(); ++d)
+	{
+		VectorXr centered = samples.col(d).array() - samples.col(d).mean();
+		real_t variance = centered.squaredNorm()/n;
+		if (variance <= 0) continue;
+		// tau = -1 + 2 * sum of the positive pair sums rho(2k) + rho(2k+1)
+		real_t tau = -1.0;
+		for (int lag = 0; lag + 1 < n/2; lag += 2)
+		{
+			real_t rho_even = centered.head(n - lag).dot(centered.tail(n - lag))/(n*variance);
+			real_t rho_odd = centered.head(n - lag - 1).dot(centered.tail(n - lag - 1))/(n*variance);
+			if (rho_even + rho_odd < 0) break;
+			tau += 2*(rho_even + rho_odd);
+		}
+		min_ess = min(min_ess, n/max(tau, (real_t)1.0/n));
+	}
+	return min_ess;
+}
+
+real_t Hamiltonian_MC::getESSPerGradient(){
+	return ess_per_gradient;
+}
 
 void Hamiltonian_MC::fit_map(int _numstart){
 	if (init)
 	{	
-		typedef double T;
+		typedef real_t T;
     	typedef LogisticRegressionWrapper<T> LogRegWrapper;
     	LogRegWrapper fun(*X_train, *Y_train,lambda);
-		MatrixXd _weights(_numstart, dim);
-		VectorXd initial_w = VectorXd::Random(dim);
-		cppoptlib::Criteria<double> crit = cppoptlib::Criteria<double>::defaults(); // Create a Criteria class to set the solver's stop conditions
+		MatrixXr _weights(_numstart, dim);
+		VectorXr initial_w(dim);
+		for (int i = 0; i < dim; ++i) initial_w(i) = 2.0*generator.uniform()-1.0;
+		cppoptlib::Criteria<real_t> crit = cppoptlib::Criteria<real_t>::defaults(); // Create a Criteria class to set the solver's stop conditions
     	cppoptlib::BfgsSolver<LogRegWrapper> solver;
     	solver.setStopCriteria(crit);
 		for (int i = 0; i < _numstart; ++i)
@@ -197,6 +466,8 @@ void Hamiltonian_MC::fit_map(int _numstart){
 			
 		}
 		weights = _weights;
+		reset_mean();
+		accumulate_mean(weights.transpose());
 	}
 	else{
 		cout << "Error: No initialized function"<< endl;
@@ -204,7 +475,7 @@ void Hamiltonian_MC::fit_map(int _numstart){
        
 }
 
-void Hamiltonian_MC::setData(MatrixXd &_X,VectorXd &_Y){
+void Hamiltonian_MC::setData(MatrixXr &_X,VectorXr &_Y){
 	if (init)
 	{	
 		logistic_regression.setData(_X,_Y);
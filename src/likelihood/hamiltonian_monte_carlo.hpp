@@ -14,33 +14,59 @@
 #include <Eigen/Dense>
 #include <Eigen/Cholesky>
 #include "logistic_regression.hpp"
+#include "../utils/random.hpp"
 
 using namespace Eigen;
 using namespace std;
 
+typedef struct nuts_tree {
+	VectorXr x_minus, p_minus, g_minus; /** leftmost state of the trajectory */
+	VectorXr x_plus, p_plus, g_plus; /** rightmost state of the trajectory */
+	VectorXr x_proposal, g_proposal; /** state sampled from the subtree */
+	real_t potential_proposal;
+	int n; /** number of states inside the slice */
+	bool s; /** false once the subtree U-turns or diverges */
+	real_t alpha; /** summed acceptance statistic, for dual averaging */
+	int n_alpha;
+} nuts_tree;
 
 class Hamiltonian_MC
 {
 public:
 	Hamiltonian_MC();
-	Hamiltonian_MC(MatrixXd &_X,VectorXd &_Y, double _lamda);
-	void run(int _iterations, double _step_size, int _num_step);
-	VectorXd simulation(VectorXd &_initial_x);
-	VectorXd predict(MatrixXd &_X_test);
+	Hamiltonian_MC(MatrixXr &_X,VectorXr &_Y, real_t _lamda);
+	void run(int _iterations, real_t _step_size, int _num_step, int _num_chains=8);
+	void simulation(MatrixXr &_x, VectorXr &_potential, MatrixXr &_gradient);
+	void run_nuts(int _iterations, int _warmup, real_t _target_accept=0.8, int _max_depth=8);
+	void run_incremental(int _iterations, int _num_step);
+	real_t getESSPerGradient();
+	VectorXr predict(const Ref<const MatrixXr> &_X_test);
 	void fit_map(int _numstart);
-	void setData(MatrixXd &_X,VectorXd &_Y);
+	void setData(MatrixXr &_X,VectorXr &_Y);
 private:
-	void leap_Frog(VectorXd &_x0, VectorXd &_v0, VectorXd &x, VectorXd &v);
-	double hamiltonian(VectorXd &_position, VectorXd &_velocity);
-	double kinetic_energy(VectorXd &_velocity);
+	void leap_Frog(MatrixXr &x, MatrixXr &v, MatrixXr &gradient, VectorXr &potential);
+	VectorXr kinetic_energy(const MatrixXr &_velocity);
+	void leapfrog_step(VectorXr &x, VectorXr &p, VectorXr &g, real_t &potential, real_t epsilon);
+	real_t momentum_energy(const VectorXr &p);
+	real_t find_step_size(const VectorXr &x, const VectorXr &g, real_t potential);
+	nuts_tree build_tree(const VectorXr &x, const VectorXr &p, const VectorXr &g, real_t log_u, int direction, int depth, real_t epsilon, real_t H0);
+	bool no_u_turn(const VectorXr &x_minus, const VectorXr &x_plus, const VectorXr &p_minus, const VectorXr &p_plus);
+	real_t effective_sample_size(const MatrixXr &samples);
+	void reset_mean();
+	void accumulate_mean(const Ref<const MatrixXr> &samples);
+	VectorXr mean_weights; /** running posterior mean, cached for predict */
+	long n_samples;
+	VectorXr inv_metric;
+	long gradient_evaluations;
+	real_t ess_per_gradient;
 	bool init;
-	double step_size;
-	int num_step, dim;
- 	MatrixXd weights;
- 	mt19937 generator;
- 	double lambda;
- 	MatrixXd *X_train;
- 	VectorXd *Y_train;
+	real_t step_size;
+	int num_step, num_chains, dim;
+ 	MatrixXr weights;
+ 	RandomStream generator;
+ 	real_t lambda;
+ 	MatrixXr *X_train;
+ 	VectorXr *Y_train;
  	LogisticRegression logistic_regression;
 };
 
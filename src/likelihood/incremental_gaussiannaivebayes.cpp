@@ -1,12 +1,13 @@
 //Author: Diego Vergara
 #include "incremental_gaussiannaivebayes.hpp"
+#include "../utils/profiler.hpp"
 
 GaussianNaiveBayes::GaussianNaiveBayes()
 {
     initialized=false;
 }
 
-GaussianNaiveBayes::GaussianNaiveBayes(MatrixXd &datos,VectorXi &clases)
+GaussianNaiveBayes::GaussianNaiveBayes(MatrixXr &datos,VectorXi &clases)
 {
     X=&datos;
     Y=&clases;
@@ -29,41 +30,40 @@ void GaussianNaiveBayes::fit()
 }
 
 
-void GaussianNaiveBayes::partial_fit(MatrixXd &datos,VectorXi &clases, double learning_rate)
+void GaussianNaiveBayes::partial_fit(const Ref<const MatrixXr> &datos,const VectorXi &clases, real_t learning_rate)
 {   
-    X=&datos;
-    Y=&clases;
-    int new_rows = getX()->rows();
-    int new_cols = getX()->cols();
+    PROFILE_SCOPE("model.gaussian_naivebayes.fit");
+    int new_rows = datos.rows();
+    int new_cols = datos.cols();
     if (initialized){
         
-        std::map<unsigned int,VectorXd> new_means, new_sigmas;
-        std::map<unsigned int,double> new_Prior;
+        std::map<unsigned int,VectorXr> new_means, new_sigmas;
+        std::map<unsigned int,real_t> new_Prior;
         #pragma omp parallel
         {
             #pragma omp single    
             for (int i = 0; i < new_rows; ++i) {        
-                if(new_means[(*getY())(i)].size()==0){
-                    new_means[(*getY())(i)] = VectorXd::Zero(new_cols);
-                    new_Prior[(*getY())(i)] = 0.0;
+                if(new_means[clases(i)].size()==0){
+                    new_means[clases(i)] = VectorXr::Zero(new_cols);
+                    new_Prior[clases(i)] = 0.0;
                 }
-                new_means[(*getY())(i)] += getX()->row(i);
-                new_Prior[(*getY())(i)] += 1.0;
+                new_means[clases(i)] += datos.row(i);
+                new_Prior[clases(i)] += 1.0;
             }
         }
         #pragma omp parallel
         {
             #pragma omp single    
             for (int i = 0; i < new_rows; ++i){   
-                if(new_sigmas[(*getY())(i)].size()==0){
-                    new_means[(*getY())(i)] /= new_Prior[(*getY())(i)];
-                    new_Prior[(*getY())(i)] /= new_rows;
-                    new_sigmas[(*getY())(i)] = VectorXd::Zero(new_cols);
+                if(new_sigmas[clases(i)].size()==0){
+                    new_means[clases(i)] /= new_Prior[clases(i)];
+                    new_Prior[clases(i)] /= new_rows;
+                    new_sigmas[clases(i)] = VectorXr::Zero(new_cols);
                 }
-                new_sigmas[(*getY())(i)] =  new_sigmas[(*getY())(i)].array() +(getX()->row(i).transpose() - new_means[(*getY())(i)]).array().square(); 
+                new_sigmas[clases(i)] =  new_sigmas[clases(i)].array() +(datos.row(i).transpose() - new_means[clases(i)]).array().square(); 
             }
         } 
-        std::map<unsigned int,double>::iterator iter;
+        std::map<unsigned int,real_t>::iterator iter;
         for (iter = new_Prior.begin(); iter != new_Prior.end(); ++iter) {  
             new_sigmas[iter->first] /= new_Prior[iter->first] * new_rows; 
         }
@@ -81,11 +81,11 @@ void GaussianNaiveBayes::partial_fit(MatrixXd &datos,VectorXi &clases, double le
         else{
             // Update model
             if (Cols == new_cols){
-                std::map<unsigned int,double>::iterator iter;
+                std::map<unsigned int,real_t>::iterator iter;
                 for (iter = new_Prior.begin(); iter != new_Prior.end(); ++iter) {  
                     if(Means[iter->first].size()==0){
-                            Means[iter->first] = VectorXd::Zero(new_cols);
-                            Sigmas[iter->first] = VectorXd::Zero(new_cols);
+                            Means[iter->first] = VectorXr::Zero(new_cols);
+                            Sigmas[iter->first] = VectorXr::Zero(new_cols);
                             Prior[iter->first] = 0.0;
                     }
                     Means[iter->first] =  ((1-learning_rate)*Means[iter->first]*Prior[iter->first]*Rows + (learning_rate)*new_means[iter->first]*iter->second*new_rows) 
@@ -119,29 +119,55 @@ void GaussianNaiveBayes::partial_fit(MatrixXd &datos,VectorXi &clases, double le
     }
 
 }
-double GaussianNaiveBayes::log_likelihood(VectorXd data, VectorXd mean, VectorXd sigma){
-    double loglike =0.0;
-    double eps = std::numeric_limits<double>::epsilon();
-    loglike = -0.5 * (((2*M_PI*sigma).array()+eps).log()).sum();
+/* Means and variances of the given feature columns taken from this batch
+alone, for columns that now hold a different feature; the other columns and
+the priors keep their running values. */
+void GaussianNaiveBayes::reset_features(const Ref<const MatrixXr> &datos, const VectorXi &clases, const vector<int> &columns)
+{
+    if (!initialized || !one_fit){
+        cout << "Error: Model not initialized or not previously fitted" << endl;
+        return;
+    }
+    std::map<unsigned int,VectorXr>::iterator iter;
+    for (iter = Means.begin(); iter != Means.end(); ++iter) {
+        unsigned int label = iter->first;
+        int count = (clases.array() == (int)label).count();
+        if (count == 0) continue;
+        for (size_t k = 0; k < columns.size(); ++k) {
+            int j = columns[k];
+            real_t mean = 0.0, variance = 0.0;
+            for (int i = 0; i < datos.rows(); ++i) if (clases(i) == (int)label) mean += datos(i,j);
+            mean /= count;
+            for (int i = 0; i < datos.rows(); ++i) if (clases(i) == (int)label) variance += (datos(i,j)-mean)*(datos(i,j)-mean);
+            Means[label](j) = mean;
+            Sigmas[label](j) = variance/count;
+        }
+    }
+}
+
+real_t GaussianNaiveBayes::log_likelihood(VectorXr data, VectorXr mean, VectorXr sigma){
+    real_t loglike =0.0;
+    real_t eps = std::numeric_limits<real_t>::epsilon();
+    loglike = -0.5 * (((real_t(2*M_PI)*sigma).array()+eps).log()).sum();
     loglike -= 0.5 * (((data - mean).array().square())/(sigma.array()+eps)).sum();
     return loglike;
 }
 
-double GaussianNaiveBayes::likelihood(VectorXd data, VectorXd mean, VectorXd sigma){
-    double likelihood =0.0;
-    double eps = std::numeric_limits<double>::epsilon();
-    likelihood = ((-((data - mean).array().square())/(2*sigma.array()+eps)).exp() / (2*M_PI*sigma).array().square()).prod();
+real_t GaussianNaiveBayes::likelihood(VectorXr data, VectorXr mean, VectorXr sigma){
+    real_t likelihood =0.0;
+    real_t eps = std::numeric_limits<real_t>::epsilon();
+    likelihood = ((-((data - mean).array().square())/(2*sigma.array()+eps)).exp() / (real_t(2*M_PI)*sigma).array().square()).prod();
     return likelihood;
 }
 
-VectorXi GaussianNaiveBayes::predict(MatrixXd &Xtest)
+VectorXi GaussianNaiveBayes::predict(const Ref<const MatrixXr> &Xtest)
 {
     VectorXi c=VectorXi::Zero(Xtest.rows());
     if (initialized){
         int max_class=0;
-        double max_score=-100000000.0;
-        double score=0;
-        std::map<unsigned int,double>::iterator iter;
+        real_t max_score=-100000000.0;
+        real_t score=0;
+        std::map<unsigned int,real_t>::iterator iter;
         #pragma omp parallel for private(max_class,max_score,score,iter)
         for (int i = 0; i < Xtest.rows(); ++i) {
             max_class=0;
@@ -165,11 +191,11 @@ VectorXi GaussianNaiveBayes::predict(MatrixXd &Xtest)
 
 }
 
-MatrixXd GaussianNaiveBayes::get_proba(MatrixXd &Xtest)
+MatrixXr GaussianNaiveBayes::get_proba(const Ref<const MatrixXr> &Xtest)
 {   
-    MatrixXd proba = MatrixXd::Zero(Xtest.rows(), Prior.size());
+    MatrixXr proba = MatrixXr::Zero(Xtest.rows(), Prior.size());
     if (initialized){
-        std::map<unsigned int,double>::iterator iter;
+        std::map<unsigned int,real_t>::iterator iter;
         #pragma omp parallel for private(iter)
         for (int i = 0; i < Xtest.rows(); ++i) {
             for (iter = Prior.begin(); iter != Prior.end(); ++iter) {  
@@ -189,13 +215,14 @@ MatrixXd GaussianNaiveBayes::get_proba(MatrixXd &Xtest)
 
 }
 
-VectorXd GaussianNaiveBayes::predict_proba(MatrixXd &Xtest, int target)
+VectorXr GaussianNaiveBayes::predict_proba(const Ref<const MatrixXr> &Xtest, int target)
 {   
-    MatrixXd proba = MatrixXd::Zero(Xtest.rows(), Prior.size());
-    MatrixXd normalization_const = MatrixXd::Zero(Xtest.rows(), Prior.size());
-    VectorXd log_sum_exp = VectorXd::Zero(Xtest.rows());
+    PROFILE_SCOPE("likelihood.gaussian_naivebayes");
+    MatrixXr proba = MatrixXr::Zero(Xtest.rows(), Prior.size());
+    MatrixXr normalization_const = MatrixXr::Zero(Xtest.rows(), Prior.size());
+    VectorXr log_sum_exp = VectorXr::Zero(Xtest.rows());
     if (initialized){
-        std::map<unsigned int,double>::iterator iter;
+        std::map<unsigned int,real_t>::iterator iter;
         #pragma omp parallel for private(iter)
         for (int i = 0; i < Xtest.rows(); ++i) {
             for (iter = Prior.begin(); iter != Prior.end(); ++iter) {  
@@ -203,7 +230,7 @@ VectorXd GaussianNaiveBayes::predict_proba(MatrixXd &Xtest, int target)
 
             }
         }
-        VectorXd max_val=proba.rowwise().maxCoeff();
+        VectorXr max_val=proba.rowwise().maxCoeff();
         normalization_const = proba.colwise()-max_val;
         log_sum_exp= proba.col(target).array() - normalization_const.array().exp().rowwise().sum();
         return log_sum_exp;
@@ -216,21 +243,21 @@ VectorXd GaussianNaiveBayes::predict_proba(MatrixXd &Xtest, int target)
 }
 
 
-std::map<unsigned int, double> GaussianNaiveBayes::getPrior() const
+std::map<unsigned int, real_t> GaussianNaiveBayes::getPrior() const
 {
     return Prior;
 }
 
-void GaussianNaiveBayes::setPrior(const std::map<unsigned int, double> &value)
+void GaussianNaiveBayes::setPrior(const std::map<unsigned int, real_t> &value)
 {
     Prior = value;
 }
- MatrixXd *GaussianNaiveBayes::getX() 
+ MatrixXr *GaussianNaiveBayes::getX() 
 {
     return X;
 }
 
-void GaussianNaiveBayes::setX( MatrixXd *value)
+void GaussianNaiveBayes::setX( MatrixXr *value)
 {
     X = value;
 }
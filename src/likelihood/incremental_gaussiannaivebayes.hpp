@@ -10,6 +10,8 @@
 #include <map>
 #include <string>
 #include <fstream>
+#include <vector>
+#include "../utils/real.hpp"
 
 using namespace Eigen;
 using namespace std;
@@ -18,26 +20,27 @@ using namespace std;
 class GaussianNaiveBayes{
 public:
     GaussianNaiveBayes();
-    GaussianNaiveBayes(MatrixXd &X, VectorXi &Y);
+    GaussianNaiveBayes(MatrixXr &X, VectorXi &Y);
     void fit();
-    void partial_fit(MatrixXd &X, VectorXi &Y, double learning_rate);
-    VectorXi predict(MatrixXd &Xtest);
-    MatrixXd get_proba(MatrixXd &Xtest);
-    VectorXd predict_proba(MatrixXd &Xtest, int target);
-    double log_likelihood(VectorXd data, VectorXd mean, VectorXd sigma);
-    double likelihood(VectorXd data, VectorXd mean, VectorXd sigma);
-    std::map<unsigned int, double> getPrior() const;
-    void setPrior(const std::map<unsigned int, double> &value);
-    MatrixXd *getX();
-    void setX(MatrixXd *value);
+    void partial_fit(const Ref<const MatrixXr> &X, const VectorXi &Y, real_t learning_rate);
+    void reset_features(const Ref<const MatrixXr> &X, const VectorXi &Y, const vector<int> &columns);
+    VectorXi predict(const Ref<const MatrixXr> &Xtest);
+    MatrixXr get_proba(const Ref<const MatrixXr> &Xtest);
+    VectorXr predict_proba(const Ref<const MatrixXr> &Xtest, int target);
+    real_t log_likelihood(VectorXr data, VectorXr mean, VectorXr sigma);
+    real_t likelihood(VectorXr data, VectorXr mean, VectorXr sigma);
+    std::map<unsigned int, real_t> getPrior() const;
+    void setPrior(const std::map<unsigned int, real_t> &value);
+    MatrixXr *getX();
+    void setX(MatrixXr *value);
     VectorXi *getY() ;
     void setY( VectorXi *value);
 
 private:
-    MatrixXd *X;
+    MatrixXr *X;
     VectorXi *Y;
-    std::map<unsigned int,VectorXd> Means, Sigmas;
-    std::map<unsigned int,double> Prior;
+    std::map<unsigned int,VectorXr> Means, Sigmas;
+    std::map<unsigned int,real_t> Prior;
     bool initialized, one_fit;
     int Rows, Cols;
 };
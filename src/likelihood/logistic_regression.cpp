@@ -1,162 +1,258 @@
 #include "logistic_regression.hpp"
+#include "../utils/profiler.hpp"
 
 LogisticRegression::LogisticRegression(){
+	laplace=false;
 }
 
-LogisticRegression::LogisticRegression(MatrixXd &_X,VectorXd &_Y,double _lambda){
+LogisticRegression::LogisticRegression(MatrixXr &_X,VectorXr &_Y,real_t _lambda){
 	lambda=_lambda;
+	laplace=false;
  	X_train = &_X;
  	Y_train = &_Y;
- 	VectorXi indices = VectorXi::LinSpaced(X_train->rows(), 0, X_train->rows());
- 	srand((unsigned int) time(0));
- 	std::random_shuffle(indices.data(), indices.data() + X_train->rows());
+ 	VectorXi indices = VectorXi::LinSpaced(X_train->rows(), 0, X_train->rows()-1);
+ 	std::shuffle(indices.data(), indices.data() + X_train->rows(), generator);
   	X_train->noalias() = indices.asPermutation() * *X_train;  
   	Y_train->noalias() = indices.asPermutation() * *Y_train; 
  	rows = X_train->rows();
 	dim = X_train->cols();
-	weights = RowVectorXd::Random(dim);
+	weights = RowVectorXr(dim);
+	for (int i = 0; i < dim; ++i) weights(i) = 2.0*generator.uniform()-1.0;
+	// no bias term, the data is centered instead; setData and predict reuse these means
 	featureMeans = X_train->colwise().mean();
 	X_train->rowwise()-=featureMeans.transpose();
 	/*X_train->conservativeResize(NoChange, dim+1);
-	VectorXd bias_vec=VectorXd::Constant(rows,1.0);
+	VectorXr bias_vec=VectorXr::Constant(rows,1.0);
 	X_train->col(dim) = bias_vec;*/
  }
 
-VectorXd LogisticRegression::sigmoid(VectorXd &eta){
-	VectorXd phi =eta.unaryExpr([](double elem) // changed type of parameter
-	{
-		double maxcut=log(std::numeric_limits<float>::max_exponent);
-		double mincut=log(std::numeric_limits<float>::min_exponent);
-	    elem=max(elem,mincut);
-	    elem=min(elem,maxcut);
-	    double p= (elem>0) ? 1.0/(1.0+exp(-elem)) : exp(elem)/(1.0+exp(elem));
-	    return p;
-	});
+static real_t clipped_sigmoid(real_t elem){
+	real_t maxcut=log(std::numeric_limits<float>::max());
+	real_t mincut=-maxcut;
+    elem=max(elem,mincut);
+    elem=min(elem,maxcut);
+    real_t p= (elem>0) ? 1.0/(1.0+exp(-elem)) : exp(elem)/(1.0+exp(elem));
+    return p;
+}
+
+static real_t clipped_log_sigmoid(real_t elem){
+	//real_t realmin=numeric_limits<real_t>::min();
+	real_t maxcut=log(std::numeric_limits<float>::max());
+	real_t mincut=-maxcut;
+    elem=max(elem,mincut);
+    elem=min(elem,maxcut);
+    real_t p= (elem>0) ? -log(1.0+exp(-elem)) : elem-log(1.0+exp(elem));
+    return p;
+}
+
+VectorXr LogisticRegression::sigmoid(VectorXr &eta){
+	VectorXr phi =eta.unaryExpr([](real_t elem){ return clipped_sigmoid(elem); });
 	return phi;
 }
 
-VectorXd LogisticRegression::logSigmoid(VectorXd &eta){
-	VectorXd phi = eta.unaryExpr([](double elem) // changed type of parameter
-	{
-		//double realmin=numeric_limits<double>::min();
-		double maxcut=log(std::numeric_limits<float>::max_exponent);
-		double mincut=log(std::numeric_limits<float>::min_exponent);
-	    elem=max(elem,mincut);
-	    elem=min(elem,maxcut);
-	    double p= (elem>0) ? -log(1.0+exp(-elem)) : elem-log(1.0+exp(elem));
-	    return p;
-	});
+VectorXr LogisticRegression::logSigmoid(VectorXr &eta){
+	VectorXr phi = eta.unaryExpr([](real_t elem){ return clipped_log_sigmoid(elem); });
 	return phi;
 }
 
 
-VectorXd LogisticRegression::train(int n_iter,double alpha,double tol){
-	VectorXd log_likelihood=VectorXd::Zero(n_iter);
-	MatrixXd H(rows,rows);
+VectorXr LogisticRegression::train(int n_iter,real_t alpha,real_t tol){
+	VectorXr log_likelihood=VectorXr::Zero(n_iter);
 	for(int i=0;i<n_iter;i++){
-		VectorXd Grad=gradient(weights);
+		VectorXr Grad=gradient(weights);
 		log_likelihood(i)=logPosterior(weights);
 		//cout << i << ", ll:" << log_likelihood(i)  <<endl;
 		weights.noalias()=weights-alpha*Grad.transpose();
 	}
 	//cout << "end training!" << endl;
-	Hessian = computeHessian(*X_train,*Y_train,weights);
+	computeLaplace();
 	return log_likelihood;
 }
 
+int LogisticRegression::fit_map(int max_iterations,real_t tol){
+	/*MAP weights by L-BFGS, warm-started from the current weights, followed
+	by the Laplace approximation N(w_map, H^-1) of the posterior.
+	Returns the number of L-BFGS iterations.*/
+	PROFILE_SCOPE("model.logistic_regression.fit_map");
+	typedef LogisticRegressionWrapper<real_t> LogRegWrapper;
+	LogRegWrapper fun(this);
+	cppoptlib::Criteria<real_t> crit = cppoptlib::Criteria<real_t>::defaults();
+	crit.iterations = max_iterations;
+	crit.gradNorm = tol;
+	cppoptlib::LbfgsSolver<LogRegWrapper> solver;
+	solver.setStopCriteria(crit);
+	VectorXr w = weights.transpose();
+	solver.minimize(fun, w);
+	weights = w.transpose();
+	computeLaplace();
+	PROFILE_COUNT("lbfgs_iterations",solver.criteria().iterations);
+	return solver.criteria().iterations;
+}
+
+void LogisticRegression::computeLaplace(){
+	bool centered = (featureMeans.size() == dim);
+	if(dim > LAPLACE_FULL_MAX_DIM){
+		// mean-field Laplace, O(n d) per fit
+		hessian_diagonal = computeHessianDiagonal(*X_train,*Y_train,weights);
+		Hessian.resize(0,0);
+		laplace = true;
+		if(centered) centered_offset = featureMeans.cwiseQuotient(hessian_diagonal.cwiseSqrt());
+		return;
+	}
+	Hessian = computeHessian(*X_train,*Y_train,weights);
+	hessian_llt.compute(Hessian);
+	laplace = (hessian_llt.info() == Success);
+	if(!laplace) cout << "Error: Hessian is not positive definite" << endl;
+	else if(centered) centered_offset = hessian_llt.matrixL().solve(featureMeans);
+}
+
 
-VectorXd LogisticRegression::computeGradient(MatrixXd &_X, VectorXd &_Y, RowVectorXd &_W){
-	VectorXd eta = (_X*_W.transpose());
-	VectorXd YZ=_Y.cwiseProduct(eta);
-	VectorXd Phi=sigmoid(YZ);
+VectorXr LogisticRegression::computeGradient(MatrixXr &_X, VectorXr &_Y, RowVectorXr &_W){
+	VectorXr eta = (_X*_W.transpose());
+	VectorXr YZ=_Y.cwiseProduct(eta);
+	VectorXr Phi=sigmoid(YZ);
 	Phi.noalias()=_Y.cwiseProduct((Phi.array()-1).matrix());
-	VectorXd E_d=_X.transpose()*Phi;
-	VectorXd E_w=(lambda)*weights.transpose();
-	VectorXd grad=(E_d+E_w);
+	VectorXr E_d=_X.transpose()*Phi;
+	VectorXr E_w=(lambda)*_W.transpose();
+	VectorXr grad=(E_d+E_w);
 	return grad;
 }
 
-MatrixXd LogisticRegression::computeHessian(const MatrixXd &_X,  VectorXd &_Y,RowVectorXd &_W){
-	VectorXd eta = (_X*_W.transpose());
-	VectorXd YZ=_Y.cwiseProduct(eta);
-	MatrixXd I=MatrixXd::Identity(dim,dim);
-	VectorXd P=sigmoid(YZ);
-	MatrixXd H=MatrixXd::Zero(dim,dim);
-	MatrixXd J=MatrixXd::Zero(rows,rows);
-	J.diagonal() << P.array()*(1-P.array()).array();
-	cout << "data " << _Y.rows() << "," << _Y.cols() << "," << _X.rows() << "," << _X.cols() << endl;
-	MatrixXd H_temp=_X.transpose();
-	//H_temp *= J;
-	//H.noalias()=H_temp*_X;
-	H+=lambda*I;
-	return H.inverse();
+MatrixXr LogisticRegression::computeHessian(const MatrixXr &_X,  VectorXr &_Y,RowVectorXr &_W){
+	// X^T diag(p(1-p)) X + lambda I as a rank update of sqrt(p(1-p)) X,
+	// O(n d^2) and without the n x n diagonal matrix
+	VectorXr eta = (_X*_W.transpose());
+	VectorXr YZ=_Y.cwiseProduct(eta);
+	VectorXr P=sigmoid(YZ);
+	VectorXr S=(P.array()*(1-P.array())).sqrt();
+	MatrixXr XS=S.asDiagonal()*_X;
+	MatrixXr H=lambda*MatrixXr::Identity(dim,dim);
+	H.selfadjointView<Lower>().rankUpdate(XS.transpose());
+	H.triangularView<StrictlyUpper>()=H.transpose();
+	return H;
 }
 
-VectorXd LogisticRegression::predict(MatrixXd &_X,bool prob){
+VectorXr LogisticRegression::computeHessianDiagonal(const MatrixXr &_X,  VectorXr &_Y,RowVectorXr &_W){
+	// diag(X^T diag(p(1-p)) X) + lambda, O(n d)
+	VectorXr eta = (_X*_W.transpose());
+	VectorXr YZ=_Y.cwiseProduct(eta);
+	VectorXr P=sigmoid(YZ);
+	VectorXr S=P.array()*(1-P.array());
+	VectorXr H=_X.cwiseAbs2().transpose()*S;
+	H.array()+=lambda;
+	return H;
+}
+
+VectorXr LogisticRegression::predict(const Ref<const MatrixXr> &_X,bool prob){
 	//Hessian = ComputeHessian(*X_train,*Y_train,weights);
 	//cout << "data " << Y_train->rows() << "," << Y_train->cols() << "," << X_train->rows() << "," << X_train->cols() << endl;
-	MatrixXd *X_test=&_X;
-	//X_test->rowwise()-=featureMeans.transpose();
-	VectorXd phi=VectorXd::Zero(X_test->rows());
-	VectorXd eta = (*X_test)*weights.transpose();
+	// centered like the training data, (x - m)^T w = x^T w - m^T w
+	bool centered = (featureMeans.size() == _X.cols());
+	VectorXr phi=VectorXr::Zero(_X.rows());
+	VectorXr eta = _X*weights.transpose();
+	if(centered) eta.array() -= featureMeans.dot(weights.transpose());
+	if(laplace){
+		// probit approximation of the Laplace predictive (MacKay 1992):
+		// p(y=1|x) ~ sigmoid(kappa x^T w), kappa = (1 + pi s^2 / 8)^-1/2, s^2 = x^T H^-1 x
+		// L^-1 (x - m) = L^-1 x - L^-1 m, the offset is solved once per fit
+		MatrixXr V;
+		if(Hessian.size() > 0) V = hessian_llt.matrixL().solve(_X.transpose());
+		else V = hessian_diagonal.cwiseSqrt().cwiseInverse().asDiagonal()*_X.transpose();
+		if(centered) V.colwise() -= centered_offset;
+		VectorXr s2 = V.colwise().squaredNorm().transpose();
+		eta = eta.cwiseQuotient((1.0 + (M_PI/8.0)*s2.array()).sqrt().matrix());
+	}
 	if(prob){
 		phi=logSigmoid(eta);		
 	}
 	else{
 		phi=sigmoid(eta);
-		phi.noalias() = phi.unaryExpr([](double elem){
-	    	return (elem > 0.5) ? 1.0 : -1.0;
+		phi.noalias() = phi.unaryExpr([](real_t elem){
+	    	return (elem > 0.5) ? real_t(1.0) : real_t(-1.0);
 		});
 	}
 	/*int n_samples=100;
 	MVNGaussian posterior(weights.transpose(),Hessian);
 	for(int i=0; i< n_samples;i++){
-		VectorXd sample_weight=posterior.sample();
+		VectorXr sample_weight=posterior.sample();
 		cout << sample_weight.size() << endl;
 		cout << X_test->rows() << "," << X_test->cols() << endl;
-		VectorXd eta = *X_test*sample_weight;
+		VectorXr eta = *X_test*sample_weight;
 		//phi+=(1.0/n_samples)*Sigmoid(eta);	
 	}*/
 	return phi;
 }
 
-double LogisticRegression::logLikelihood(MatrixXd &_X,VectorXd &_Y,RowVectorXd &_W){
-	VectorXd eta = (_X*_W.transpose());
-	VectorXd YZ=_Y.cwiseProduct(eta);
-	VectorXd logPhi=logSigmoid(YZ);
+real_t LogisticRegression::logLikelihood(MatrixXr &_X,VectorXr &_Y,RowVectorXr &_W){
+	VectorXr eta = (_X*_W.transpose());
+	VectorXr YZ=_Y.cwiseProduct(eta);
+	VectorXr logPhi=logSigmoid(YZ);
 	return logPhi.sum();
 }
 
-double LogisticRegression::logPrior(RowVectorXd &_W){
+real_t LogisticRegression::logPrior(RowVectorXr &_W){
 	return -(lambda/2.0)*_W.squaredNorm();
 }
 
-double LogisticRegression::logPosterior(RowVectorXd& _weights){
-	double log_likelihood=-logLikelihood(*X_train,*Y_train,_weights)-logPrior(_weights);
+real_t LogisticRegression::logPosterior(RowVectorXr& _weights){
+	real_t log_likelihood=-logLikelihood(*X_train,*Y_train,_weights)-logPrior(_weights);
     return log_likelihood;
 }
 
-VectorXd LogisticRegression::gradient(RowVectorXd& _weights){
+VectorXr LogisticRegression::gradient(RowVectorXr& _weights){
 	return computeGradient(*X_train,*Y_train, _weights);
 }
 
-void LogisticRegression::setWeights(VectorXd& _W){
+// Batched over chains: every column of _W is one weight vector, so the whole
+// batch costs one X*W matrix-matrix product instead of C matrix-vector passes.
+VectorXr LogisticRegression::batchLogPosterior(const Ref<const MatrixXr>& _W){
+	MatrixXr YZ = Y_train->asDiagonal()*((*X_train)*_W);
+	VectorXr log_likelihood = YZ.unaryExpr([](real_t elem){ return clipped_log_sigmoid(elem); }).colwise().sum().transpose();
+	VectorXr log_prior = -(lambda/2.0)*_W.colwise().squaredNorm().transpose();
+	return -log_likelihood-log_prior;
+}
+
+MatrixXr LogisticRegression::batchGradient(const Ref<const MatrixXr>& _W){
+	MatrixXr YZ = Y_train->asDiagonal()*((*X_train)*_W);
+	MatrixXr Phi = YZ.unaryExpr([](real_t elem){ return clipped_sigmoid(elem); });
+	Phi = Y_train->asDiagonal()*(Phi.array()-1.0).matrix();
+	return X_train->transpose()*Phi+lambda*_W;
+}
+
+// Both of the above from a single X*W product, for callers that need the
+// potential and the gradient at the same point.
+VectorXr LogisticRegression::batchLogPosterior(const Ref<const MatrixXr>& _W, MatrixXr& _gradient){
+	MatrixXr YZ = Y_train->asDiagonal()*((*X_train)*_W);
+	VectorXr log_likelihood = YZ.unaryExpr([](real_t elem){ return clipped_log_sigmoid(elem); }).colwise().sum().transpose();
+	VectorXr log_prior = -(lambda/2.0)*_W.colwise().squaredNorm().transpose();
+	MatrixXr Phi = YZ.unaryExpr([](real_t elem){ return clipped_sigmoid(elem); });
+	Phi = Y_train->asDiagonal()*(Phi.array()-1.0).matrix();
+	_gradient = X_train->transpose()*Phi+lambda*_W;
+	return -log_likelihood-log_prior;
+}
+
+void LogisticRegression::setWeights(VectorXr& _W){
 	weights=_W.transpose();
+	laplace=false;
 }
 
-VectorXd LogisticRegression::getWeights(){
+VectorXr LogisticRegression::getWeights(){
 	return weights;
 }
 
-void LogisticRegression::setData(MatrixXd &_X,VectorXd &_Y){
+VectorXr LogisticRegression::getFeatureMeans(){
+	return featureMeans;
+}
+
+void LogisticRegression::setData(MatrixXr &_X,VectorXr &_Y){
 	X_train = &_X;
  	Y_train = &_Y;
- 	VectorXi indices = VectorXi::LinSpaced(X_train->rows(), 0, X_train->rows());
- 	srand((unsigned int) time(0));
- 	std::random_shuffle(indices.data(), indices.data() + X_train->rows());
+ 	VectorXi indices = VectorXi::LinSpaced(X_train->rows(), 0, X_train->rows()-1);
+ 	std::shuffle(indices.data(), indices.data() + X_train->rows(), generator);
   	X_train->noalias() = indices.asPermutation() * *X_train;  
   	Y_train->noalias() = indices.asPermutation() * *Y_train; 
  	rows = X_train->rows();
 	dim = X_train->cols();
-	featureMeans = X_train->colwise().mean();
+	// same centering as the first fit, so the warm-started weights keep their meaning
+	if(featureMeans.size() == dim) X_train->rowwise()-=featureMeans.transpose();
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 #include <Eigen/Dense>
 #include <Eigen/Cholesky>
 #include "multivariate_gaussian.hpp"
+#include "../utils/random.hpp"
+#include "../utils/real.hpp"
 #include "../libs/cppoptlib/meta.h"
 #include "../libs/cppoptlib/problem.h"
 #include "../libs/cppoptlib/solver/bfgssolver.h"
@@ -19,34 +21,50 @@
 using namespace Eigen;
 using namespace std;
 
+// above this many features the Laplace posterior keeps only the diagonal of
+// the precision, the full one costs O(d^3) per fit and O(d^2 n) per predict
+const int LAPLACE_FULL_MAX_DIM=512;
+
 class LogisticRegression
 {
  public:
 	LogisticRegression();
-	LogisticRegression(MatrixXd &_X,VectorXd &_Y,double lambda=1.0);
- 	VectorXd train(int n_iter,double alpha=0.01,double tol=0.001);
- 	VectorXd predict(MatrixXd &_X,bool prob=true);
- 	double logPosterior(RowVectorXd& _weights);
- 	VectorXd gradient(RowVectorXd& _weights);
- 	void setWeights(VectorXd &_W);
-    void setData(MatrixXd &_X,VectorXd &_Y);
- 	VectorXd getWeights();
+	LogisticRegression(MatrixXr &_X,VectorXr &_Y,real_t lambda=1.0);
+ 	VectorXr train(int n_iter,real_t alpha=0.01,real_t tol=0.001);
+ 	int fit_map(int max_iterations=100,real_t tol=1e-4);
+ 	VectorXr predict(const Ref<const MatrixXr> &_X,bool prob=true);
+ 	real_t logPosterior(RowVectorXr& _weights);
+ 	VectorXr gradient(RowVectorXr& _weights);
+ 	VectorXr batchLogPosterior(const Ref<const MatrixXr>& _W);
+ 	MatrixXr batchGradient(const Ref<const MatrixXr>& _W);
+ 	VectorXr batchLogPosterior(const Ref<const MatrixXr>& _W, MatrixXr& _gradient);
+ 	void setWeights(VectorXr &_W);
+    void setData(MatrixXr &_X,VectorXr &_Y);
+ 	VectorXr getWeights();
+ 	VectorXr getFeatureMeans();
 
 
  private:
- 	RowVectorXd weights;
- 	MatrixXd *X_train;
- 	VectorXd *Y_train;
+ 	RowVectorXr weights;
+ 	MatrixXr *X_train;
+ 	VectorXr *Y_train;
  	int rows,dim;
- 	double lambda;
- 	VectorXd featureMeans;
- 	VectorXd sigmoid(VectorXd &_eta);
- 	VectorXd logSigmoid(VectorXd &_eta);
- 	MatrixXd computeHessian(const MatrixXd &_X,  VectorXd &_Y,RowVectorXd &_W);
- 	VectorXd computeGradient(MatrixXd &_X, VectorXd &_Y,RowVectorXd &_W);
- 	double logPrior(RowVectorXd &_W);
- 	double logLikelihood(MatrixXd &_X,VectorXd &_Y,RowVectorXd &_W);
- 	MatrixXd Hessian;
+ 	real_t lambda;
+ 	VectorXr featureMeans;
+ 	VectorXr sigmoid(VectorXr &_eta);
+ 	VectorXr logSigmoid(VectorXr &_eta);
+ 	MatrixXr computeHessian(const MatrixXr &_X,  VectorXr &_Y,RowVectorXr &_W);
+ 	void computeLaplace();
+ 	VectorXr computeGradient(MatrixXr &_X, VectorXr &_Y,RowVectorXr &_W);
+ 	real_t logPrior(RowVectorXr &_W);
+ 	real_t logLikelihood(MatrixXr &_X,VectorXr &_Y,RowVectorXr &_W);
+ 	VectorXr computeHessianDiagonal(const MatrixXr &_X,  VectorXr &_Y,RowVectorXr &_W);
+ 	MatrixXr Hessian; /** posterior precision at the MAP, X^T diag(p(1-p)) X + lambda I */
+ 	LLT<MatrixXr> hessian_llt;
+ 	VectorXr hessian_diagonal; /** diag(Hessian), used instead of it when dim > LAPLACE_FULL_MAX_DIM */
+ 	VectorXr centered_offset; /** L^-1 m, or m/sqrt(diag H), subtracted from L^-1 x in predict */
+ 	bool laplace; /** predict with the Laplace posterior instead of the point estimate */
+ 	RandomStream generator;
 };
 
 
@@ -54,20 +72,34 @@ template<typename T>
 class LogisticRegressionWrapper : public cppoptlib::Problem<T> {
   public:
     using typename cppoptlib::Problem<T>::TVector;
+    using typename cppoptlib::Problem<T>::TMatrix;
+    using typename cppoptlib::Problem<T>::TValues;
     LogisticRegression *logistic;
 
-    LogisticRegressionWrapper(MatrixXd &X_, VectorXd &y_,double _lambda) {
+    LogisticRegressionWrapper(MatrixXr &X_, VectorXr &y_,real_t _lambda) {
       logistic=new LogisticRegression(X_,y_,_lambda);
     }
 
+    // wraps an existing model without taking ownership
+    LogisticRegressionWrapper(LogisticRegression *_logistic) {
+      logistic=_logistic;
+    }
+
     T value(const TVector &beta) {
-        Eigen::RowVectorXd w=beta.transpose();
-        return logistic->logPosterior(w);
+        return logistic->batchLogPosterior(beta)(0);
     }
 
     void gradient(const TVector &beta, TVector &grad) {
-        Eigen::RowVectorXd w=beta.transpose();
-        grad = logistic->gradient(w);
+        grad = logistic->batchGradient(beta);
+    }
+
+    // a whole population in one X*W product
+    void valueBatch(const TMatrix &W, TValues &f) {
+        f = logistic->batchLogPosterior(W);
+    }
+
+    void gradientBatch(const TMatrix &W, TMatrix &grads) {
+        grads = logistic->batchGradient(W);
     }
 
     int getDim(){
@@ -1,62 +1,91 @@
 #include "multinomial.hpp"
+#include "../utils/utils.hpp"
+#include <limits>
 
 Multinomial::Multinomial()
 {
 
 }
-Multinomial::Multinomial(VectorXd &theta)
+Multinomial::Multinomial(VectorXr &theta)
 {
 
     setTheta(theta);
 }
 
-Multinomial::Multinomial(MatrixXd &counts, double &alpha)
+Multinomial::Multinomial(MatrixXr &counts, real_t &alpha)
 {
-    sufficient=VectorXd(counts.cols());
-    double total=counts.sum()+counts.cols()*alpha;
+    sufficient=VectorXr(counts.cols());
+    real_t total=counts.sum()+counts.cols()*alpha;
     // std::cout<<"counts sum:"<<counts.sum() << " "<<counts.cols()<<std::endl;
-    theta=VectorXd(counts.cols());
+    theta=VectorXr(counts.cols());
     //#pragma omp parallel for
     for (int i = 0; i < counts.cols(); ++i) {
          theta(i)=(counts.col(i).sum()+alpha)/total;
          sufficient(i)=counts.col(i).sum();
     }
+    update_cache();
 }
 
-Multinomial::Multinomial(VectorXd &sufficient,double &alpha)
+Multinomial::Multinomial(VectorXr &sufficient,real_t &alpha)
 {
-    this->sufficient=VectorXd(sufficient.size());
+    this->sufficient=VectorXr::Zero(sufficient.size());
     addTheta(sufficient,alpha);
 
 }
 
-double Multinomial::log_likelihood(const VectorXd &test)
+real_t Multinomial::log_likelihood(const VectorXr &test)
 {
-    double log_like=0.0;
-    double sum_test=0.0;
-    double sum_theta=0.0;
+    real_t sum_test=0.0;
     for(int i=0;i<test.size();i++){
-        sum_test+=lgamma(test[i]+1);
-        sum_theta+= (this->theta[i]!=0.0) ? test[i]*log(this->theta[i]) : 0.0;
+        if(test[i]>0) sum_test+=log_factorial(test[i]);
+    }
+    return log_factorial(test.sum())-sum_test+test.dot(log_theta);
+}
+
+/* one histogram per row: a single matrix-vector product with log(theta) plus
+the multinomial coefficient of every row */
+VectorXr Multinomial::batch_log_likelihood(const Ref<const MatrixXr> &counts)
+{
+    VectorXr log_like=counts*log_theta;
+    #pragma omp parallel for
+    for(int i=0;i<counts.rows();i++){
+        real_t total=0.0;
+        real_t sum_test=0.0;
+        for(int j=0;j<counts.cols();j++){
+            real_t c=counts(i,j);
+            if(c>0){
+                total+=c;
+                sum_test+=log_factorial(c);
+            }
+        }
+        log_like[i]+=log_factorial(total)-sum_test;
     }
-    log_like=lgamma(test.sum()+1)-sum_test+sum_theta;
     return log_like;
 }
 
-VectorXd Multinomial::getTheta() const
+/* empty bins get the log of the smallest normal real_t, so zero counts
+multiply a finite number in the matrix product */
+void Multinomial::update_cache()
+{
+    log_theta=theta.array().max(std::numeric_limits<real_t>::min()).log();
+}
+
+VectorXr Multinomial::getTheta() const
 {
     return theta;
 }
 
-void Multinomial::setTheta(const VectorXd &value)
+void Multinomial::setTheta(const VectorXr &value)
 {
     theta = value;
+    update_cache();
 }
-void Multinomial::addTheta(VectorXd &value,double &alpha)
+void Multinomial::addTheta(VectorXr &value,real_t &alpha)
 {
     if(sufficient.size()==0)
-        this->sufficient=VectorXd(value.size());
+        this->sufficient=VectorXr::Zero(value.size());
     sufficient+=value;
     theta= (sufficient.array()+alpha);
-    theta/=(sufficient.sum() +value.cols()*alpha);
+    theta/=(sufficient.sum() +value.size()*alpha);
+    update_cache();
 }
@@ -7,6 +7,7 @@
 #include <Eigen/Dense>
 #include <iostream>
 #include <vector>
+#include "../utils/real.hpp"
 
 
 using namespace Eigen;
@@ -15,20 +16,23 @@ class Multinomial
 {
 public:
     Multinomial();
-    // Multinomial(MatrixXd &counts);
-    Multinomial(MatrixXd &counts, double &alpha);
-    Multinomial(VectorXd &thetas);
-    Multinomial(VectorXd &sufficient,double &alpha);
-    double log_likelihood(const VectorXd &test);
+    // Multinomial(MatrixXr &counts);
+    Multinomial(MatrixXr &counts, real_t &alpha);
+    Multinomial(VectorXr &thetas);
+    Multinomial(VectorXr &sufficient,real_t &alpha);
+    real_t log_likelihood(const VectorXr &test);
+    VectorXr batch_log_likelihood(const Ref<const MatrixXr> &counts);
 
-    VectorXd getTheta() const;
-    void setTheta(const VectorXd &value);
-    void addTheta(VectorXd &value, double &alpha);
+    VectorXr getTheta() const;
+    void setTheta(const VectorXr &value);
+    void addTheta(VectorXr &value, real_t &alpha);
 
 
 private:
-    VectorXd theta;
-    VectorXd sufficient;
+    void update_cache();
+    VectorXr theta;
+    VectorXr log_theta; /** log(theta), refreshed whenever theta changes */
+    VectorXr sufficient;
 
 };
 
@@ -1,114 +1,130 @@
 #include "multinomialnaivebayes.hpp"
+#include "../utils/profiler.hpp"
 
 MultinomialNaiveBayes::MultinomialNaiveBayes()
 {
     initialized=false;
 }
 
-MultinomialNaiveBayes::MultinomialNaiveBayes(MatrixXd &datos,VectorXd &clases)
+MultinomialNaiveBayes::MultinomialNaiveBayes(MatrixXr &datos,VectorXr &clases)
 {
     X=&datos;
     Y=&clases;
     initialized=true;
 }
 
-void MultinomialNaiveBayes::fit(double alpha)
+void MultinomialNaiveBayes::class_counts(const Ref<const MatrixXr> &datos, const VectorXr &clases, MatrixXr &counts, VectorXr &n_samples)
 {
-    if(initialized)
-    {
-        #pragma omp parallel
-        {
-            #pragma omp single
-            for (int i = 0; i < getY()->rows(); ++i) {
-                if(Xc_sufficient[(*getY())(i)].size()==0)
-                {
-                    Xc_sufficient[(*getY())(i)]=VectorXd::Zero(X->cols());
-                    Prior[(*getY())(i)]=0;
-                    classes[(*getY())(i)]=Multinomial();
-                }
-                Xc_sufficient[(*getY())(i)]+= getX()->row(i);
-                Prior[(*getY())(i)]=(Prior[(*getY())(i)]+1.0)/getX()->rows();
-                classes[(*getY())(i)].addTheta(Xc_sufficient[(*getY())(i)],alpha);
-            }
-        }
+    int n_classes = (int)clases.maxCoeff()+1;
+    if(feature_counts.rows() > n_classes) n_classes = feature_counts.rows();
+    counts = MatrixXr::Zero(n_classes, datos.cols());
+    n_samples = VectorXr::Zero(n_classes);
+    for (int i = 0; i < datos.rows(); ++i) {
+        int c = (int)clases(i);
+        counts.row(c) += datos.row(i);
+        n_samples(c) += 1.0;
     }
+}
 
+void MultinomialNaiveBayes::update_log_theta()
+{
+    // log theta_kd = log(N_kd + alpha) - log(N_k + D alpha)
+    int n_features = feature_counts.cols();
+    VectorXr totals = feature_counts.rowwise().sum().array() + n_features*alpha;
+    log_theta = (feature_counts.array() + alpha).log();
+    log_theta.colwise() -= totals.array().log().matrix();
+    log_prior = (class_samples.array()/class_samples.sum()).log().matrix().transpose();
 }
 
-VectorXd MultinomialNaiveBayes::test(MatrixXd &Xtest)
+void MultinomialNaiveBayes::fit(real_t _alpha)
 {
-    VectorXd c=VectorXd::Zero(Xtest.rows());
-    int max_class=0;
-    double max_score=-100000000.0;
-    double score=0;
-    std::map<unsigned int,Multinomial>::iterator iter;
-    #pragma omp parallel for private(max_class,max_score,score,iter)
-    for (int i = 0; i < Xtest.rows(); ++i) {
-        max_class=0;
-        max_score=-100000000.0;
-        for (iter = classes.begin(); iter != classes.end(); ++iter) {
-            score=log(getPrior()[iter->first])+iter->second.log_likelihood(Xtest.row(i));
-            if(score > max_score){
-                max_score=score;
-                max_class=iter->first;
-            }
-        }
-        c(i)=max_class;
+    PROFILE_SCOPE("model.multinomial_naivebayes.fit");
+    if(initialized)
+    {
+        alpha = _alpha;
+        class_counts(*getX(), *getY(), feature_counts, class_samples);
+        update_log_theta();
+    }
+    else{
+        cout << "Error: Model not initialized" << endl;
     }
-    return c;
 }
 
-MatrixXd  MultinomialNaiveBayes::get_proba(MatrixXd &Xtest)
+void MultinomialNaiveBayes::partial_fit(const Ref<const MatrixXr> &datos, const VectorXr &clases, real_t learning_rate)
 {
-    MatrixXd proba = MatrixXd::Zero(Xtest.rows(), classes.size());
-    //VectorXd log_prob_x = VectorXd::Zero(Xtest.rows());
-    if (initialized){
-        std::map<unsigned int,Multinomial>::iterator iter;
-        #pragma omp parallel for private(iter)
-        for (int i = 0; i < Xtest.rows(); ++i) {
-            for (iter = classes.begin(); iter != classes.end(); ++iter) {
-                proba(i, iter->first)=log(getPrior()[iter->first])+iter->second.log_likelihood(Xtest.row(i));
-            }
-        }
-        //log_prob_x = (proba.array().exp()).rowwise().sum().log();
-        //for (int i = 0; i < proba.cols(); ++i) proba.col(i) -= log_prob_x;
-        double max = proba.maxCoeff();
-        double min = proba.minCoeff();
-        proba = (proba.array() - min)/(max-min);
-        return proba;
+    PROFILE_SCOPE("model.multinomial_naivebayes.partial_fit");
+    if(!initialized || log_theta.size() == 0){
+        cout << "Error: Model not initialized or not fitted" << endl;
+        return;
     }
-    else{
-        return proba;
+    if(datos.cols() != feature_counts.cols()){
+        cout << "Error: Inconsistent data (colums size)" << endl;
+        return;
+    }
+    // exponential forgetting of the sufficient statistics, same weighting as
+    // GaussianNaiveBayes::partial_fit
+    MatrixXr new_counts;
+    VectorXr new_samples;
+    class_counts(datos, clases, new_counts, new_samples);
+    int old_classes = feature_counts.rows();
+    if(new_counts.rows() > old_classes){
+        feature_counts.conservativeResize(new_counts.rows(), NoChange);
+        class_samples.conservativeResize(new_counts.rows());
+        feature_counts.bottomRows(new_counts.rows()-old_classes).setZero();
+        class_samples.tail(new_counts.rows()-old_classes).setZero();
     }
+    feature_counts = (1-learning_rate)*feature_counts + learning_rate*new_counts;
+    class_samples = (1-learning_rate)*class_samples + learning_rate*new_samples;
+    update_log_theta();
 }
 
-std::map<unsigned int, double> MultinomialNaiveBayes::getPrior() const
+VectorXr MultinomialNaiveBayes::test(const Ref<const MatrixXr> &Xtest)
 {
-    return Prior;
+    MatrixXr proba = get_proba(Xtest);
+    VectorXr c(Xtest.rows());
+    for (int i = 0; i < Xtest.rows(); ++i) {
+        int max_class;
+        proba.row(i).maxCoeff(&max_class);
+        c(i)=max_class;
+    }
+    return c;
 }
 
-void MultinomialNaiveBayes::setPrior(const std::map<unsigned int, double> &value)
+/* log posterior of every class, one row per sample. The multinomial
+coefficient is the same for every class and cancels in the normalization,
+so it is never computed */
+MatrixXr  MultinomialNaiveBayes::get_proba(const Ref<const MatrixXr> &Xtest)
 {
-    Prior = value;
+    PROFILE_SCOPE("likelihood.multinomial_naivebayes");
+    if (!initialized || log_theta.size() == 0){
+        cout << "Error: Model not initialized or not fitted" << endl;
+        return MatrixXr::Zero(Xtest.rows(), 0);
+    }
+    MatrixXr proba(Xtest.rows(), log_theta.rows());
+    proba.noalias() = Xtest*log_theta.transpose();
+    proba.rowwise() += log_prior;
+    VectorXr max_score = proba.rowwise().maxCoeff();
+    VectorXr log_evidence = ((proba.colwise()-max_score).array().exp().rowwise().sum().log()).matrix() + max_score;
+    proba.colwise() -= log_evidence;
+    return proba;
 }
- 
-MatrixXd *MultinomialNaiveBayes::getX() 
+
+MatrixXr *MultinomialNaiveBayes::getX() 
 {
     return X;
 }
 
-void MultinomialNaiveBayes::setX( MatrixXd *value)
+void MultinomialNaiveBayes::setX( MatrixXr *value)
 {
     X = value;
 }
 
- VectorXd *MultinomialNaiveBayes::getY() 
+ VectorXr *MultinomialNaiveBayes::getY() 
 {
     return Y;
 }
 
-void MultinomialNaiveBayes::setY( VectorXd *value)
+void MultinomialNaiveBayes::setY( VectorXr *value)
 {
     Y = value;
 }
-
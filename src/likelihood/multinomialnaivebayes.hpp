@@ -3,38 +3,47 @@
 
 #include <stdlib.h>
 #include <cmath>
-#include "multinomial.hpp"
 #include <Eigen/Core>
 #include <Eigen/Dense>
-#include <map>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include "../utils/real.hpp"
 
 using namespace std;
+using namespace Eigen;
 
+/**
+ * Multinomial naive Bayes over count features (LBP/MB-LBP histograms).
+ * Classes are the label values 0..K-1. The model is kept as K x D class
+ * counts, so fitting is a sum of rows and partial_fit decays the counts;
+ * scoring all samples is one X * log_theta^T product plus the log prior.
+ */
 class MultinomialNaiveBayes
 {
 public:
     MultinomialNaiveBayes();
-    MultinomialNaiveBayes(MatrixXd &X, VectorXd &Y);
-    void fit(double alpha);
-    VectorXd test(MatrixXd &Xtest);
-    MatrixXd get_proba(MatrixXd &Xtest);
-    std::map<unsigned int, double> getPrior() const;
-    void setPrior(const std::map<unsigned int, double> &value);
-    MatrixXd *getX();
-    void setX(MatrixXd *value);
-    VectorXd *getY() ;
-    void setY( VectorXd *value);
+    MultinomialNaiveBayes(MatrixXr &X, VectorXr &Y);
+    void fit(real_t alpha);
+    void partial_fit(const Ref<const MatrixXr> &X, const VectorXr &Y, real_t learning_rate);
+    VectorXr test(const Ref<const MatrixXr> &Xtest);
+    MatrixXr get_proba(const Ref<const MatrixXr> &Xtest);
+    MatrixXr *getX();
+    void setX(MatrixXr *value);
+    VectorXr *getY() ;
+    void setY( VectorXr *value);
 
 private:
-    MatrixXd *X;
-    VectorXd *Y;
-    std::map<unsigned int,Multinomial> classes;
-    std::map<unsigned int,VectorXd> Xc_sufficient;
-    std::map<unsigned int,double> Prior;
+    void class_counts(const Ref<const MatrixXr> &X, const VectorXr &Y, MatrixXr &counts, VectorXr &n_samples);
+    void update_log_theta();
+    MatrixXr *X;
+    VectorXr *Y;
+    MatrixXr feature_counts; /** K x D summed counts per class */
+    VectorXr class_samples; /** samples per class */
+    MatrixXr log_theta; /** K x D smoothed log class-conditional probabilities */
+    RowVectorXr log_prior;
+    real_t alpha;
     bool initialized;
 };
 
-#endif
\ No newline at end of file
+#endif
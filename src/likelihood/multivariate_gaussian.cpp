@@ -5,8 +5,6 @@ MVNGaussian::MVNGaussian(VectorXd _mean, MatrixXd _cov){
     mean = _mean;
     cov = _cov;
     //cout <<  "MVN Random  m:" << mean << ",cov : "<< cov  << endl;
-    unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    generator.seed(seed);
 }
 
 MVNGaussian::MVNGaussian(MatrixXd &data){
@@ -21,8 +19,6 @@ MVNGaussian::MVNGaussian(MatrixXd &data){
     /* Covariance Matrix */
     centered = data.rowwise() - mean.transpose();
     cov = (centered.adjoint() * centered) / double(data.rows() - 1);
-    unsigned seed = chrono::system_clock::now().time_since_epoch().count();
-    generator.seed(seed);
 }
 
 VectorXd MVNGaussian::getMean(void){
@@ -43,9 +39,8 @@ void MVNGaussian::setCov(MatrixXd _cov){
 
 VectorXd MVNGaussian::sample(){
     VectorXd mvn_sample=VectorXd::Zero(dim);
-    VectorXd mvn_random=VectorXd::Random(dim);
-    normal_distribution<double> normal(0.0,1.0);
-    for (int i=0;i<dim;i++) mvn_random(i)=normal(generator);
+    VectorXd mvn_random(dim);
+    generator.fill_normal(mvn_random);
     LLT<MatrixXd> cholSolver(cov);       
     MatrixXd upperL = cholSolver.matrixL();
     mvn_sample= upperL*mvn_random+ mean;
@@ -53,17 +48,8 @@ VectorXd MVNGaussian::sample(){
 }
 
 MatrixXd MVNGaussian::sample(int n_samples){
-    MatrixXd mvn_sample,mvn_random;
-    srand((unsigned int) time(0));
-    mvn_random=MatrixXd::Zero(n_samples,dim);
-    mvn_random.noalias() = mvn_random.unaryExpr([](double elem) // changed type of parameter
-    {
-        unsigned seed = chrono::system_clock::now().time_since_epoch().count();
-        mt19937 generator(seed);
-        normal_distribution<double> normal(0.0,1.0);
-        elem=normal(generator);
-        return elem;
-    });
+    MatrixXd mvn_sample,mvn_random(n_samples,dim);
+    generator.fill_normal(mvn_random);
     LLT<MatrixXd> cholSolver(cov);
     MatrixXd upperL = cholSolver.matrixL();
     mvn_sample= mvn_random*upperL;
@@ -7,6 +7,7 @@
 #include <Eigen/Cholesky>
 #include <chrono>
 #include <random>
+#include "../utils/random.hpp"
 
 using namespace Eigen;
 using namespace std;
@@ -25,7 +26,7 @@ class MVNGaussian{
     private:
         VectorXd mean;
         MatrixXd cov;
-        mt19937 generator;
+        RandomStream generator;
         int dim;
 };
 
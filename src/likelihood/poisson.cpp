@@ -1,4 +1,6 @@
 #include "poisson.hpp"
+#include "../utils/utils.hpp"
+#include <cfloat>
 
 Poisson::Poisson()
 {
@@ -12,19 +14,37 @@ Poisson::Poisson(VectorXd &lambda)
 
 double Poisson::log_likelihood(const VectorXd &test)
 {
-    double log_like=0.0;
     double sum_test=0.0;
-    double sum_lambda=0.0;
-    unsigned int i=0;
-    //#pragma omp parallel for private(i) reduction(+:sum_test) reduction(+:sum_lambda)
-    for(i=0;i<test.size();i++){
-        sum_test+=lgamma(test[i]+1)+this->lambda[i];
-        sum_lambda+=test[i]*log(this->lambda[i]);
+    for(int i=0;i<test.size();i++){
+        if(test[i]>0) sum_test+=log_factorial(test[i]);
+    }
+    return test.dot(log_lambda)-lambda_sum-sum_test;
+}
+
+/* one count vector per row: a single matrix-vector product with log(lambda)
+plus the log k! of the non-empty bins */
+VectorXd Poisson::batch_log_likelihood(const Ref<const MatrixXd> &counts)
+{
+    VectorXd log_like=counts*log_lambda;
+    #pragma omp parallel for
+    for(int i=0;i<counts.rows();i++){
+        double sum_test=0.0;
+        for(int j=0;j<counts.cols();j++){
+            if(counts(i,j)>0) sum_test+=log_factorial(counts(i,j));
+        }
+        log_like[i]-=lambda_sum+sum_test;
     }
-    log_like=sum_lambda-sum_test;
     return log_like;
 }
 
+/* empty rates get the log of the smallest double, so zero counts multiply a
+finite number in the matrix product */
+void Poisson::update_cache()
+{
+    log_lambda=lambda.array().max(DBL_MIN).log();
+    lambda_sum=lambda.sum();
+}
+
 VectorXd Poisson::getLambda() const
 {
     return lambda;
@@ -33,13 +53,15 @@ VectorXd Poisson::getLambda() const
 void Poisson::setLambda(const VectorXd &value)
 {
     lambda = value;
+    update_cache();
 }
 
 void Poisson::addLambda(VectorXd &value)
 {
     if(sufficient.size()==0)
-        this->sufficient=VectorXd(value.size());
+        this->sufficient=VectorXd::Zero(value.size());
     sufficient+=value;
     sample_size++;
     lambda= sufficient/sample_size;
+    update_cache();
 }
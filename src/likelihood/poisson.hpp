@@ -17,13 +17,17 @@ public:
     Poisson();
     Poisson(VectorXd &lambda);
     double log_likelihood(const VectorXd &test);
+    VectorXd batch_log_likelihood(const Ref<const MatrixXd> &counts);
 
     VectorXd getLambda() const;
     void setLambda(const VectorXd &lambda);
     void addLambda(VectorXd &value);
 
 private:
+    void update_cache();
     VectorXd lambda;
+    VectorXd log_lambda; /** log(lambda), refreshed whenever lambda changes */
+    double lambda_sum;
     VectorXd sufficient;
     double sample_size;
 
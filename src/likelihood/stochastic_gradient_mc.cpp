@@ -0,0 +1,143 @@
+#include "stochastic_gradient_mc.hpp"
+#include "../utils/profiler.hpp"
+
+StochasticGradientMC::StochasticGradientMC(){
+	init = false;
+}
+
+StochasticGradientMC::StochasticGradientMC(real_t _lambda, int _buffer_size, int _batch_size, bool _hamiltonian, real_t _friction){
+	lambda = _lambda;
+	buffer_size = _buffer_size;
+	batch_size = _batch_size;
+	hamiltonian = _hamiltonian;
+	friction = _friction;
+	dim = 0;
+	buffer_count = 0;
+	buffer_head = 0;
+	n_samples = 0;
+	init = true;
+}
+
+void StochasticGradientMC::add_examples(const Ref<const MatrixXr> &_X, const Ref<const VectorXr> &_Y){
+	if (!init)
+	{
+		cout << "Error: No initialized function"<< endl;
+		return;
+	}
+	if (dim == 0)
+	{
+		dim = _X.cols();
+		X_buffer = MatrixXr(buffer_size, dim);
+		Y_buffer = VectorXr(buffer_size);
+		// centered like the other backends, the first batch fixes the means
+		// that predict subtracts; no bias term
+		MatrixXr X_first = _X;
+		VectorXr Y_first = _Y;
+		logistic_regression = LogisticRegression(X_first, Y_first, lambda);
+		feature_means = logistic_regression.getFeatureMeans();
+		feature_scale = 0.25*X_first.colwise().squaredNorm().transpose()/X_first.rows();
+		// at zero every example scores 1/2, a random start would saturate on
+		// raw feature magnitudes
+		weights = VectorXr::Zero(dim);
+		velocity = VectorXr::Zero(dim);
+		mean_weights = weights;
+		logistic_regression.setWeights(mean_weights);
+	}
+	else if (_X.cols() != dim)
+	{
+		cout << "Error: Inconsistent data (colums size)" << endl;
+		return;
+	}
+	// ring buffer, the newest examples overwrite the oldest ones
+	for (int i = 0; i < _X.rows(); ++i)
+	{
+		X_buffer.row(buffer_head) = _X.row(i) - feature_means.transpose();
+		Y_buffer(buffer_head) = _Y(i);
+		buffer_head = (buffer_head + 1) % buffer_size;
+		buffer_count = min(buffer_count + 1, buffer_size);
+	}
+}
+
+VectorXr StochasticGradientMC::stochastic_gradient(const VectorXr &_weights){
+	// unbiased estimate of the full-data gradient of -log posterior
+	int n_batch = min(batch_size, buffer_count);
+	MatrixXr X_batch(n_batch, dim);
+	VectorXr Y_batch(n_batch);
+	for (int i = 0; i < n_batch; ++i)
+	{
+		int index = min((int)(generator.uniform()*buffer_count), buffer_count - 1);
+		X_batch.row(i) = X_buffer.row(index);
+		Y_batch(i) = Y_buffer(index);
+	}
+	VectorXr YZ = Y_batch.cwiseProduct(X_batch*_weights);
+	VectorXr Phi = YZ.unaryExpr([](real_t elem){ return (real_t)(1.0/(1.0 + exp(-elem))); });
+	Phi = Y_batch.cwiseProduct((Phi.array() - 1.0).matrix());
+	return ((real_t)buffer_count/n_batch)*(X_batch.transpose()*Phi) + lambda*_weights;
+}
+
+void StochasticGradientMC::run(int _iterations, real_t _step_size, int _burn_in){
+	/*Summary
+    Parameters
+    ----------
+    iterations : int
+        Number of stochastic-gradient steps
+    step_size : real_t
+        Learning rate (SGLD) or eta (SGHMC), relative to the curvature of
+        each coordinate: coordinate j moves with step_size/(N s_j + lambda)
+    burn_in : int
+        Leading steps left out of the posterior mean
+    */
+	PROFILE_SCOPE("model.sgmc.run");
+	if (!init || buffer_count == 0)
+	{
+		cout << "Error: No initialized function or empty replay buffer"<< endl;
+		return;
+	}
+	// diagonal preconditioner from the curvature bound of the current buffer,
+	// so the step does not depend on the feature magnitudes
+	VectorXr step = _step_size*(buffer_count*feature_scale.array() + lambda).inverse().matrix();
+	VectorXr noise(dim);
+	for (int t = 0; t < _iterations; ++t)
+	{
+		VectorXr gradient = stochastic_gradient(weights);
+		generator.fill_normal(noise);
+		if (hamiltonian)
+		{
+			// SGHMC (Chen et al. 2014), friction compensates the gradient noise
+			velocity = (1.0 - friction)*velocity - step.cwiseProduct(gradient) + (2.0*friction*step).cwiseSqrt().cwiseProduct(noise);
+			weights += velocity;
+		}
+		else
+		{
+			// SGLD (Welling & Teh 2011)
+			weights += -0.5*step.cwiseProduct(gradient) + step.cwiseSqrt().cwiseProduct(noise);
+		}
+		if (t >= _burn_in)
+		{
+			n_samples++;
+			mean_weights += (weights - mean_weights)/n_samples;
+		}
+	}
+	PROFILE_COUNT("sgmc_minibatch_gradients",_iterations);
+	// the old posterior weighs at most as much as one run of new draws
+	n_samples = min(n_samples, (long)max(_iterations - _burn_in, 1));
+	logistic_regression.setWeights(mean_weights);
+}
+
+VectorXr StochasticGradientMC::predict(const Ref<const MatrixXr> &_X_test){
+	PROFILE_SCOPE("likelihood.sgmc");
+	VectorXr predict;
+	if (init && dim > 0)
+	{
+		predict = logistic_regression.predict(_X_test);
+		return predict;
+	}
+	else{
+		cout << "Error: No initialized function"<< endl;
+		return predict;
+	}
+}
+
+VectorXr StochasticGradientMC::getWeights(){
+	return mean_weights;
+}
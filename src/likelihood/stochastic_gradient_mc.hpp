@@ -0,0 +1,48 @@
+#ifndef STOCHASTIC_GRADIENT_MC_H
+#define STOCHASTIC_GRADIENT_MC_H
+#include <iostream>
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include "logistic_regression.hpp"
+#include "../utils/random.hpp"
+#include "../utils/real.hpp"
+
+using namespace Eigen;
+using namespace std;
+
+/**
+ * Stochastic-gradient MCMC (SGLD / SGHMC) for Bayesian logistic regression.
+ * Examples live in a bounded replay buffer, the oldest are overwritten once it
+ * is full, and every step uses a minibatch drawn from it, so an update costs
+ * O(batch) no matter how long the tracker has been running.
+ */
+class StochasticGradientMC
+{
+public:
+	StochasticGradientMC();
+	StochasticGradientMC(real_t _lambda, int _buffer_size=2000, int _batch_size=32, bool _hamiltonian=true, real_t _friction=0.1);
+	void add_examples(const Ref<const MatrixXr> &_X, const Ref<const VectorXr> &_Y);
+	void run(int _iterations, real_t _step_size, int _burn_in=0);
+	VectorXr predict(const Ref<const MatrixXr> &_X_test);
+	VectorXr getWeights();
+private:
+	VectorXr stochastic_gradient(const VectorXr &_weights);
+	bool init, hamiltonian;
+	int dim, buffer_size, batch_size, buffer_count, buffer_head;
+	real_t lambda, friction;
+	MatrixXr X_buffer; /** centered with the means of the first batch */
+	VectorXr Y_buffer;
+	VectorXr weights, velocity;
+	VectorXr feature_means;
+	VectorXr feature_scale; /** per-example curvature bound x_j^2/4, sets the step per coordinate */
+	VectorXr mean_weights; /** running posterior mean, cached for predict */
+	long n_samples;
+	RandomStream generator;
+	LogisticRegression logistic_regression;
+};
+
+#endif // STOCHASTIC_GRADIENT_MC_H
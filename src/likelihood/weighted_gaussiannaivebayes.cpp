@@ -1,149 +1,78 @@
 // Author: Diego Vergara
 #include "weighted_gaussiannaivebayes.hpp"
+#include "../utils/profiler.hpp"
+#include <limits>
 
-GaussianNaiveBayes::GaussianNaiveBayes()
-{
-    initialized=true;
-}
-
-
-void GaussianNaiveBayes::fit(MatrixXd &datos,VectorXi &clases,VectorXd weights)
-{   
-    if (initialized){
-        X=&datos;
-        Y=&clases;
-        int rows = X->rows();
-        int cols = X->cols();
-        double total_weights = 0.0; // new
-        #pragma omp parallel
-        {
-            #pragma omp single    
-            for (int i = 0; i < rows; ++i) {        
-                if(means[(*getY())(i)].size()==0){
-                    means[(*getY())(i)] = VectorXd::Zero(cols);
-                    //ix[(*getY())(i)] = 0;
-                    ac_weight[(*getY())(i)] = 0;
-                }
-                means[(*getY())(i)] += weights(i)*X->row(i);
-                //ix[(*getY())(i)] += 1;
-                ac_weight[(*getY())(i)]+= weights(i);
-                total_weights += weights(i); // new
-            }
-        }
-        #pragma omp parallel
-        {
-            #pragma omp single    
-            for (int i = 0; i < rows; ++i){   
-                if(sigmas[(*getY())(i)].size()==0){
-                    means[(*getY())(i)] /= ac_weight[(*getY())(i)];
-                    sigmas[(*getY())(i)] = VectorXd::Zero(cols);
-                }
-                sigmas[(*getY())(i)] =  sigmas[(*getY())(i)].array() +((X->row(i).transpose() - means[(*getY())(i)]).array().square() * weights(i)); 
-            }
-        }  
-
-        std::map<unsigned int,double>::iterator iter;
-        //for (iter = ix.begin(); iter != ix.end(); ++iter) {
-        for (iter = ac_weight.begin(); iter != ac_weight.end(); ++iter) {                          
-            //sigmas[iter->first] /= ac_weight[iter->first];
-            sigmas[iter->first] /= iter->second;
-            //Prior[iter->first] = (iter->second + 0.0)/rows;
-            Prior[iter->first] = (iter->second + 0.0)/total_weights;
-        }
-    }
-}
-double GaussianNaiveBayes::log_likelihood(VectorXd data, VectorXd mean, VectorXd sigma){
-    double loglike =0.0;
-    loglike = -0.5 * ((2*M_PI*sigma).array().log()).sum();
-    loglike -= 0.5 * (((data - mean).array().square())/sigma.array()).sum();
-    return loglike;
-}
+const real_t VAR_SMOOTHING=1e-9;
 
-VectorXi GaussianNaiveBayes::test(MatrixXd &Xtest)
+WeightedGaussianNaiveBayes::WeightedGaussianNaiveBayes()
 {
-    VectorXi c=VectorXi::Zero(Xtest.rows());
-    if (initialized){
-        int max_class=0;
-        double max_score=-100000000.0;
-        double score=0;
-        //std::map<unsigned int,int>::iterator iter;
-        std::map<unsigned int,double>::iterator iter;
-        #pragma omp parallel for private(max_class,max_score,score,iter)
-        for (int i = 0; i < Xtest.rows(); ++i) {
-            max_class=0;
-            max_score= -100000000.0;
-            //for (iter = ix.begin(); iter != ix.end(); ++iter) {  
-            for (iter = ac_weight.begin(); iter != ac_weight.end(); ++iter) {  
-                score=log(getPrior()[iter->first]) + log_likelihood(Xtest.row(i), means[iter->first], sigmas[iter->first]);
-                if(score > max_score){
-                    max_score=score;
-                    max_class=iter->first;
-                }
-            }
-            c(i)=max_class;
-        }
-        return c;
-    }
-    else{
-        return c;
-    }
-
+    initialized=false;
 }
 
-MatrixXd GaussianNaiveBayes::get_proba(MatrixXd &Xtest)
-{   
-    //MatrixXd proba = MatrixXd::Zero(Xtest.rows(), ix.size());
-    MatrixXd proba = MatrixXd::Zero(Xtest.rows(), ac_weight.size());
-    //VectorXd log_prob_x = VectorXd::Zero(Xtest.rows());
-    if (initialized){
-        //std::map<unsigned int,int>::iterator iter;
-        std::map<unsigned int,double>::iterator iter;
-        #pragma omp parallel for private(iter)
-        for (int i = 0; i < Xtest.rows(); ++i) {
-            //for (iter = ix.begin(); iter != ix.end(); ++iter) {  
-            for (iter = ac_weight.begin(); iter != ac_weight.end(); ++iter) {  
-                proba(i, iter->first)=log(getPrior()[iter->first]) + log_likelihood(Xtest.row(i), means[iter->first], sigmas[iter->first]);
-            }
-        }
-        //log_prob_x = (proba.array().exp()).rowwise().sum().log();
-        //for (int i = 0; i < proba.cols(); ++i) proba.col(i) -= log_prob_x;
-        double max = proba.maxCoeff();
-        double min = proba.minCoeff();
-        proba = (proba.array() - min)/(max-min);
-        return proba;
+void WeightedGaussianNaiveBayes::fit(const Ref<const MatrixXr> &datos, const VectorXi &clases, const VectorXr &weights)
+{
+    PROFILE_SCOPE("model.weighted_gaussian_naivebayes.fit");
+    if (datos.rows() != clases.size() || datos.rows() != weights.size()){
+        cout << "Error: Inconsistent data (rows size)" << endl;
+        return;
     }
-    else{
-        return proba;
+    int n_classes = clases.maxCoeff()+1;
+    // class_weights(k,i) = weight of sample i if it belongs to class k
+    MatrixXr class_weights = MatrixXr::Zero(n_classes, datos.rows());
+    for (int i = 0; i < datos.rows(); ++i) class_weights(clases(i), i) = weights(i);
+    VectorXr total_weights = class_weights.rowwise().sum().cwiseMax(std::numeric_limits<real_t>::min());
+    means.noalias() = class_weights*datos;
+    means.array().colwise() /= total_weights.array();
+    // second pass on data centered per class, E[x^2]-E[x]^2 cancels on raw
+    // rectangle sums in single precision
+    MatrixXr variances(n_classes, datos.cols());
+    for (int k = 0; k < n_classes; ++k){
+        variances.row(k).noalias() = class_weights.row(k)*(datos.rowwise() - means.row(k)).cwiseAbs2();
     }
-
+    variances.array().colwise() /= total_weights.array();
+    // scores are expanded around the overall mean, for the same reason
+    offset = (total_weights.transpose()*means)/total_weights.sum();
+    means.rowwise() -= offset;
+    // same floor as scikit-learn, a fraction of the largest feature variance
+    real_t epsilon = VAR_SMOOTHING*max(variances.maxCoeff(), real_t(1.0));
+    variances = variances.cwiseMax(epsilon);
+    precisions = variances.cwiseInverse();
+    log_prior = (total_weights/total_weights.sum()).array().log();
+    log_normalizer = (log_prior.array()
+        - 0.5*(2*M_PI*variances.array()).log().rowwise().sum()
+        - 0.5*(means.cwiseAbs2().cwiseProduct(precisions)).array().rowwise().sum()).matrix().transpose();
+    initialized=true;
 }
 
-
-std::map<unsigned int, double> GaussianNaiveBayes::getPrior() const
+int WeightedGaussianNaiveBayes::n_classes() const
 {
-    return Prior;
+    return means.rows();
 }
 
-void GaussianNaiveBayes::setPrior(const std::map<unsigned int, double> &value)
+VectorXi WeightedGaussianNaiveBayes::test(const Ref<const MatrixXr> &Xtest)
 {
-    Prior = value;
-}
- MatrixXd *GaussianNaiveBayes::getX() 
-{
-    return X;
-}
-
-void GaussianNaiveBayes::setX( MatrixXd *value)
-{
-    X = value;
-}
- VectorXi *GaussianNaiveBayes::getY() 
-{
-    return Y;
+    MatrixXr proba = get_proba(Xtest);
+    VectorXi c=VectorXi::Zero(Xtest.rows());
+    for (int i = 0; i < proba.rows(); ++i) proba.row(i).maxCoeff(&c(i));
+    return c;
 }
 
-void GaussianNaiveBayes::setY( VectorXi *value)
+/* log posterior of every class, one row per sample, with x relative to offset:
+log p(x|k) = log_normalizer_k - 0.5 x^2 . prec_k + x . (mean_k prec_k) */
+MatrixXr WeightedGaussianNaiveBayes::get_proba(const Ref<const MatrixXr> &Xtest)
 {
-    Y = value;
+    if (!initialized){
+        cout << "Error: Model not initialized or not previously fitted" << endl;
+        return MatrixXr::Zero(Xtest.rows(), 0);
+    }
+    MatrixXr centered = Xtest.rowwise() - offset;
+    MatrixXr proba(Xtest.rows(), means.rows());
+    proba.noalias() = centered*(means.cwiseProduct(precisions)).transpose();
+    proba.noalias() -= 0.5*centered.cwiseAbs2()*precisions.transpose();
+    proba.rowwise() += log_normalizer;
+    VectorXr max_score = proba.rowwise().maxCoeff();
+    VectorXr log_evidence = ((proba.colwise()-max_score).array().exp().rowwise().sum().log()).matrix() + max_score;
+    proba.colwise() -= log_evidence;
+    return proba;
 }
-
@@ -1,41 +1,41 @@
 // Author: Diego Vergara
-#ifndef GAUSSIANNAIVEBAYES_H
-#define GAUSSIANNAIVEBAYES_H
+#ifndef WEIGHTEDGAUSSIANNAIVEBAYES_H
+#define WEIGHTEDGAUSSIANNAIVEBAYES_H
 
 #include <iostream>
 #include <stdlib.h>
 #include <cmath>
-#include <eigen3/Eigen/Core>
-#include <eigen3/Eigen/Dense>
-#include <map>
+#include <Eigen/Core>
+#include <Eigen/Dense>
 #include <string>
 #include <fstream>
+#include "../utils/real.hpp"
 
 using namespace Eigen;
 using namespace std;
 
-
-class GaussianNaiveBayes{
+/**
+ * Gaussian naive Bayes with per-sample weights, the weak learner of Adaboost.
+ * Classes are the label values 0..K-1. The weighted means of all classes come
+ * from one matrix product with a K x N class-weight matrix, the variances
+ * from one product per class on the centered data, and scoring is two
+ * products with the precisions, so a boosting round costs a few GEMMs.
+ */
+class WeightedGaussianNaiveBayes{
 public:
-    GaussianNaiveBayes();
-    void fit(VectorXd weights);
-    VectorXi test(MatrixXd &Xtest);
-    MatrixXd get_proba(MatrixXd &Xtest);
-    double log_likelihood(VectorXd data, VectorXd mean, VectorXd sigma);
-    std::map<unsigned int, double> getPrior() const;
-    void setPrior(const std::map<unsigned int, double> &value);
-    void setX(MatrixXd *value);
-    void setY( VectorXi *value);
+    WeightedGaussianNaiveBayes();
+    void fit(const Ref<const MatrixXr> &X, const VectorXi &Y, const VectorXr &weights);
+    VectorXi test(const Ref<const MatrixXr> &Xtest);
+    MatrixXr get_proba(const Ref<const MatrixXr> &Xtest);
+    int n_classes() const;
 
 private:
-    MatrixXd *getX();
-    VectorXi *getY() ;
-    MatrixXd *X;
-    VectorXi *Y;
-    std::map<unsigned int,VectorXd> means, sigmas;
-    std::map<unsigned int,int> ix;
-    std::map<unsigned int,double> Prior, ac_weight;
+    MatrixXr means; /** K x D, relative to offset */
+    RowVectorXr offset; /** weighted mean of the training data */
+    MatrixXr precisions; /** K x D inverse variances */
+    VectorXr log_prior;
+    RowVectorXr log_normalizer; /** log prior - 0.5 sum log(2 pi var) - 0.5 sum mean^2/var per class */
     bool initialized;
 };
 
-#endif // GAUSSIANNAIVEBAYES_H
\ No newline at end of file
+#endif // WEIGHTEDGAUSSIANNAIVEBAYES_H
@@ -0,0 +1,208 @@
+/**
+ * @file observation_model.cpp
+ * @brief feature x likelihood observation models of the particle filter
+ */
+#include "observation_model.hpp"
+#include <limits>
+#include <cstdlib>
+
+#if defined(TRACKER_FEATURE) && defined(TRACKER_LIKELIHOOD)
+
+observation_model* make_observation_model(const TrackerConfig& config){
+    return new feature_likelihood_model<TRACKER_FEATURE,TRACKER_LIKELIHOOD>(config);
+}
+
+#else
+
+template<class Feature>
+static observation_model* make_feature_model(const TrackerConfig& config){
+    switch(config.likelihood){
+        case LIKELIHOOD_GAUSSIAN_NAIVEBAYES:
+            return new feature_likelihood_model<Feature,gnb_likelihood>(config);
+        case LIKELIHOOD_LOGISTIC_REGRESSION:
+            return new feature_likelihood_model<Feature,lr_likelihood>(config);
+        case LIKELIHOOD_MULTINOMIAL_NAIVEBAYES:
+            return new feature_likelihood_model<Feature,mnb_likelihood>(config);
+        case LIKELIHOOD_ADABOOST:
+            return new feature_likelihood_model<Feature,boost_likelihood>(config);
+        case LIKELIHOOD_BHATTACHARYYA:
+            return new feature_likelihood_model<Feature,bhattacharyya_likelihood>(config);
+    }
+    cout << "Error: unknown likelihood" << endl;
+    abort();
+}
+
+observation_model* make_observation_model(const TrackerConfig& config){
+    switch(config.feature){
+        case FEATURE_HAAR:
+            return make_feature_model<haar_feature>(config);
+        case FEATURE_LBP:
+            return make_feature_model<lbp_feature>(config);
+        case FEATURE_MB_LBP:
+            return make_feature_model<mb_lbp_feature>(config);
+        case FEATURE_HOG:
+            return make_feature_model<hog_feature>(config);
+        case FEATURE_COMPRESSIVE:
+            return make_feature_model<compressive_feature>(config);
+        case FEATURE_COLOR:
+            return make_feature_model<color_feature>(config);
+    }
+    cout << "Error: unknown feature" << endl;
+    abort();
+}
+
+#endif
+
+void gnb_likelihood::fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXi::Ones(n_positive), VectorXi::Zero(n_negative);
+    gaussian_naivebayes = GaussianNaiveBayes(training_feature_value, labels);
+    gaussian_naivebayes.fit();
+}
+
+void gnb_likelihood::partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXi::Ones(n_positive), VectorXi::Zero(n_negative);
+    gaussian_naivebayes.partial_fit(training_feature_value, labels, config.params.learning_rate);
+}
+
+void gnb_likelihood::reset_columns(MatrixXr& training_feature_value, int n_positive, int n_negative, const vector<int>& columns){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXi::Ones(n_positive), VectorXi::Zero(n_negative);
+    gaussian_naivebayes.reset_features(training_feature_value, labels, columns);
+}
+
+void gnb_likelihood::log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood){
+    int positive = 1;
+    log_likelihood = gaussian_naivebayes.predict_proba(feature_value, positive);
+}
+
+void lr_likelihood::fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXr::Ones(n_positive), VectorXr::Constant(n_negative,-1.0);
+    sampler = config.sampler;
+    real_t lambda=0.1;
+    switch(sampler){
+        case SAMPLER_SGMC:
+            stochastic_gradient_mc = StochasticGradientMC(lambda);
+            stochastic_gradient_mc.add_examples(training_feature_value, labels);
+            stochastic_gradient_mc.run(500,1e-2,250);
+            break;
+        case SAMPLER_LAPLACE:
+            logistic_regression = LogisticRegression(training_feature_value, labels,lambda);
+            logistic_regression.fit_map(100);
+            break;
+        case SAMPLER_NUTS:
+            hamiltonian_monte_carlo = Hamiltonian_MC(training_feature_value, labels,lambda);
+            hamiltonian_monte_carlo.run_nuts(300,150);
+            break;
+        case SAMPLER_HMC:
+            hamiltonian_monte_carlo = Hamiltonian_MC(training_feature_value, labels,lambda);
+            hamiltonian_monte_carlo.run(1e3,1e-2,10);
+            break;
+    }
+}
+
+void lr_likelihood::partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXr::Ones(n_positive), VectorXr::Constant(n_negative,-1.0);
+    switch(sampler){
+        case SAMPLER_SGMC:
+            // O(batch) per update however many examples have been seen
+            stochastic_gradient_mc.add_examples(training_feature_value, labels);
+            stochastic_gradient_mc.run(50,1e-2);
+            break;
+        case SAMPLER_LAPLACE:
+            // warm-started from the previous MAP, converges in a few iterations
+            logistic_regression.setData(training_feature_value, labels);
+            logistic_regression.fit_map(20);
+            break;
+        case SAMPLER_NUTS:
+        case SAMPLER_HMC:
+            hamiltonian_monte_carlo.setData(training_feature_value, labels);
+            hamiltonian_monte_carlo.run_incremental(32,10);
+            break;
+    }
+}
+
+void lr_likelihood::log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood){
+    switch(sampler){
+        case SAMPLER_SGMC:
+            log_likelihood = stochastic_gradient_mc.predict(feature_value);
+            break;
+        case SAMPLER_LAPLACE:
+            log_likelihood = logistic_regression.predict(feature_value);
+            break;
+        case SAMPLER_NUTS:
+        case SAMPLER_HMC:
+            log_likelihood = hamiltonian_monte_carlo.predict(feature_value);
+            break;
+    }
+}
+
+void mnb_likelihood::fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXr::Ones(n_positive), VectorXr::Zero(n_negative);
+    real_t lambda=0.1;
+    multinomial_naivebayes = MultinomialNaiveBayes(training_feature_value, labels);
+    multinomial_naivebayes.fit(lambda);
+}
+
+void mnb_likelihood::partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXr::Ones(n_positive), VectorXr::Zero(n_negative);
+    multinomial_naivebayes.partial_fit(training_feature_value, labels, config.params.learning_rate);
+}
+
+void mnb_likelihood::log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood){
+    MatrixXr Phi = multinomial_naivebayes.get_proba(feature_value);
+    log_likelihood = Phi.col(1)-Phi.col(0);
+}
+
+const int BOOST_ESTIMATORS=10;
+const double BOOST_LEARNING_RATE=0.1; /** naive Bayes learners are overconfident, shrinkage keeps the sample weights sane */
+
+void boost_likelihood::fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    labels.resize(n_positive+n_negative);
+    labels << VectorXi::Ones(n_positive), VectorXi::Zero(n_negative);
+    adaboost = Adaboost("samme.r", BOOST_ESTIMATORS, 1.0, BOOST_LEARNING_RATE);
+    adaboost.fit(training_feature_value, labels);
+}
+
+void boost_likelihood::partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    // boosting has no incremental form, the ensemble is refit on the new examples
+    labels.resize(n_positive+n_negative);
+    labels << VectorXi::Ones(n_positive), VectorXi::Zero(n_negative);
+    adaboost.fit(training_feature_value, labels);
+}
+
+void boost_likelihood::log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood){
+    log_likelihood = adaboost.log_odds(feature_value);
+}
+
+const real_t BHATTACHARYYA_LAMBDA=20.0; /** exp(-lambda d^2) of Perez et al., ECCV 2002 */
+
+/* mean of the normalized positive rows, the negatives play no part */
+static VectorXr mean_histogram(const Ref<const MatrixXr>& positives){
+    VectorXr sum = positives.rowwise().sum().cwiseMax(std::numeric_limits<real_t>::min());
+    VectorXr mean = (positives.array().colwise()/sum.array()).colwise().mean().transpose();
+    return mean/max(mean.sum(), std::numeric_limits<real_t>::min());
+}
+
+void bhattacharyya_likelihood::fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    reference = mean_histogram(training_feature_value.topRows(n_positive));
+    sqrt_reference = reference.cwiseSqrt();
+}
+
+void bhattacharyya_likelihood::partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config){
+    real_t learning_rate = config.params.learning_rate;
+    reference = (1-learning_rate)*reference + learning_rate*mean_histogram(training_feature_value.topRows(n_positive));
+    sqrt_reference = reference.cwiseSqrt();
+}
+
+void bhattacharyya_likelihood::log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood){
+    // d^2 = 1 - sum_b sqrt(p_b q_b), one GEMV over all boxes, rows normalized on the fly
+    row_sum = feature_value.rowwise().sum().cwiseMax(std::numeric_limits<real_t>::min());
+    log_likelihood.noalias() = feature_value.cwiseMax(0).cwiseSqrt()*sqrt_reference;
+    log_likelihood = BHATTACHARYYA_LAMBDA*(log_likelihood.array()/row_sum.array().sqrt() - 1);
+}
@@ -0,0 +1,314 @@
+/**
+ * @file observation_model.hpp
+ * @brief feature x likelihood observation models of the particle filter
+ * @details particle_filter talks to one observation_model, chosen at runtime
+ * from the TrackerConfig by make_observation_model. Each feature x likelihood
+ * combination is its own feature_likelihood_model instantiation, so the
+ * per-frame path (features of all boxes into one buffer, then one batched
+ * likelihood call) has no feature or likelihood branches, and different
+ * combinations can run side by side in one process. The model receives the
+ * BGR frame and converts it to gray once per call, unless the feature works
+ * on color.
+ *
+ * Building with TRACKER_FEATURE and TRACKER_LIKELIHOOD defined (e.g.
+ * -DTRACKER_FEATURE=hog_feature -DTRACKER_LIKELIHOOD=gnb_likelihood) makes the
+ * factory instantiate that one combination only, the runtime choice in the
+ * configuration is then ignored.
+ */
+#ifndef OBSERVATION_MODEL_H
+#define OBSERVATION_MODEL_H
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <Eigen/Dense>
+#include <vector>
+
+#include "../features/haar.hpp"
+#include "../features/compressive.hpp"
+#include "../features/color_histogram.hpp"
+#include "../features/local_binary_pattern.hpp"
+#include "../features/mb_lbp.hpp"
+#include "../features/hog.hpp"
+#include "../likelihood/logistic_regression.hpp"
+#include "../likelihood/hamiltonian_monte_carlo.hpp"
+#include "../likelihood/stochastic_gradient_mc.hpp"
+#include "../likelihood/multinomialnaivebayes.hpp"
+#include "../likelihood/incremental_gaussiannaivebayes.hpp"
+#include "../likelihood/adaboost.hpp"
+#include "../utils/tracker_config.hpp"
+#include "../utils/real.hpp"
+
+using namespace cv;
+using namespace std;
+using namespace Eigen;
+
+class observation_model {
+public:
+    virtual ~observation_model() {}
+    /** builds the features around the target and fits the likelihood */
+    virtual void initialize(Mat& image, Rect& reference_roi, vector<Rect>& positive_examples, vector<Rect>& negative_examples) = 0;
+    /** log likelihood of every box, valid until the next call */
+    virtual const VectorXr& log_likelihood(Mat& image, vector<Rect>& boxes) = 0;
+    /** online update of the likelihood with new examples */
+    virtual void update(Mat& image, Rect& reference_roi, vector<Rect>& positive_examples, vector<Rect>& negative_examples) = 0;
+    virtual int featureSize() = 0;
+};
+
+observation_model* make_observation_model(const TrackerConfig& config);
+
+/* Feature policies: init(roi, params) before the first use, refresh() to adapt
+the features to new training examples (Haar re-ranks its candidate pool)
+and list the columns that now hold a different feature, size() columns, compute() one row per box.
+set_frame() runs once per frame before any compute() on it, for the work all its
+boxes share. color features get the BGR frame, the others its gray version */
+
+const int COMPRESSIVE_FEATURES=256; /** sparse random measurements per box */
+const int HOG_FEATURES=3780; /** HOG descriptor of a 64x128 window */
+
+class haar_feature {
+public:
+    static const bool color = false;
+    void init(Rect& reference_roi, const TrackerParams& params){
+        haar.featureNum = params.haar_features;
+        haar.poolNum = params.haar_pool;
+        learning_rate = params.learning_rate;
+        haar.init(reference_roi);
+    }
+    void set_frame(Mat& grayImg){}
+    void refresh(Mat& grayImg, vector<Rect>& positive_examples, vector<Rect>& negative_examples, vector<int>& changed_columns){
+        haar.updateRanking(grayImg, positive_examples, negative_examples, learning_rate);
+        changed_columns = haar.swapped;
+    }
+    int size(){ return haar.featureNum; } /** TrackerParams::haar_features */
+    void compute(Mat& grayImg, vector<Rect>& boxes, Ref<MatrixXr> feature_value){
+        haar.getFeatureValue(grayImg, boxes, feature_value);
+    }
+private:
+    Haar haar;
+    float learning_rate;
+};
+
+class compressive_feature {
+public:
+    static const bool color = false;
+    void init(Rect& reference_roi, const TrackerParams& params){
+        compressive.init(COMPRESSIVE_FEATURES);
+    }
+    void set_frame(Mat& grayImg){}
+    void refresh(Mat& grayImg, vector<Rect>& positive_examples, vector<Rect>& negative_examples, vector<int>& changed_columns){}
+    int size(){ return compressive.getFeatureSize(); }
+    void compute(Mat& grayImg, vector<Rect>& boxes, Ref<MatrixXr> feature_value){
+        compressive.getFeatureValue(grayImg, boxes, feature_value);
+    }
+private:
+    Compressive compressive;
+};
+
+class lbp_feature {
+public:
+    static const bool color = false;
+    void init(Rect& reference_roi, const TrackerParams& params){}
+    void set_frame(Mat& grayImg){}
+    void refresh(Mat& grayImg, vector<Rect>& positive_examples, vector<Rect>& negative_examples, vector<int>& changed_columns){}
+    int size(){ return local_binary_pattern.getFeatureSize(); } /** 2x2 blocks of uniform LBP histograms */
+    void compute(Mat& grayImg, vector<Rect>& boxes, Ref<MatrixXr> feature_value){
+        local_binary_pattern.getFeatureValue(grayImg, boxes, feature_value);
+    }
+private:
+    LocalBinaryPattern local_binary_pattern;
+};
+
+class mb_lbp_feature {
+public:
+    static const bool color = false;
+    void init(Rect& reference_roi, const TrackerParams& params){
+        multiblock_local_binary_patterns = MultiScaleBlockLBP(3,59,2,true,false,3,3);
+    }
+    void set_frame(Mat& grayImg){}
+    void refresh(Mat& grayImg, vector<Rect>& positive_examples, vector<Rect>& negative_examples, vector<int>& changed_columns){}
+    int size(){ return multiblock_local_binary_patterns.getFeatureSize(); } /** 59 uniform patterns at 3 scales */
+    void compute(Mat& grayImg, vector<Rect>& boxes, Ref<MatrixXr> feature_value){
+        multiblock_local_binary_patterns.getFeatureValue(grayImg, boxes, feature_value);
+    }
+private:
+    MultiScaleBlockLBP multiblock_local_binary_patterns;
+};
+
+class hog_feature {
+public:
+    static const bool color = false;
+    void init(Rect& reference_roi, const TrackerParams& params){
+        reference_size = Size(reference_roi.width, reference_roi.height);
+    }
+    void set_frame(Mat& grayImg){}
+    void refresh(Mat& grayImg, vector<Rect>& positive_examples, vector<Rect>& negative_examples, vector<int>& changed_columns){}
+    int size(){ return HOG_FEATURES; }
+    void compute(Mat& grayImg, vector<Rect>& boxes, Ref<MatrixXr> feature_value){
+        calc_hog(grayImg, boxes, feature_value, reference_size);
+    }
+private:
+    Size reference_size;
+};
+
+class color_feature {
+public:
+    static const bool color = true;
+    void init(Rect& reference_roi, const TrackerParams& params){}
+    void set_frame(Mat& image){ color_histogram.setFrame(image); }
+    void refresh(Mat& image, vector<Rect>& positive_examples, vector<Rect>& negative_examples, vector<int>& changed_columns){}
+    int size(){ return color_histogram.getFeatureSize(); } /** H_BINS x S_BINS */
+    void compute(Mat& image, vector<Rect>& boxes, Ref<MatrixXr> feature_value){
+        color_histogram.getFeatureValue(boxes, feature_value);
+    }
+private:
+    ColorHistogram color_histogram;
+};
+
+/* Likelihood policies: fit() on the first frame and partial_fit() on model
+updates, both on a training buffer with the positives in the top rows; the
+buffer outlives the call since some models keep a pointer to it. reset_columns()
+refits, at full weight, the columns whose feature changed in refresh() */
+
+class gnb_likelihood {
+public:
+    static const bool refresh_features = true; /** re-rank the feature pool on every update */
+    void fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void reset_columns(MatrixXr& training_feature_value, int n_positive, int n_negative, const vector<int>& columns);
+    void log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood);
+private:
+    GaussianNaiveBayes gaussian_naivebayes;
+    VectorXi labels;
+};
+
+class lr_likelihood {
+public:
+    static const bool refresh_features = false;
+    void fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void reset_columns(MatrixXr& training_feature_value, int n_positive, int n_negative, const vector<int>& columns) {}
+    void log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood);
+private:
+    sampler_type sampler;
+    LogisticRegression logistic_regression;
+    Hamiltonian_MC hamiltonian_monte_carlo;
+    StochasticGradientMC stochastic_gradient_mc;
+    VectorXr labels;
+};
+
+class mnb_likelihood {
+public:
+    static const bool refresh_features = false;
+    void fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void reset_columns(MatrixXr& training_feature_value, int n_positive, int n_negative, const vector<int>& columns) {}
+    void log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood);
+private:
+    MultinomialNaiveBayes multinomial_naivebayes;
+    VectorXr labels;
+};
+
+/* SAMME.R boosted weighted Gaussian naive Bayes, refit on every update, the
+log likelihood is the mean log odds of the learners */
+class boost_likelihood {
+public:
+    static const bool refresh_features = true; /** refit from scratch, any feature set will do */
+    void fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void reset_columns(MatrixXr& training_feature_value, int n_positive, int n_negative, const vector<int>& columns) {} /** the next partial_fit refits every learner */
+    void log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood);
+private:
+    Adaboost adaboost;
+    VectorXi labels;
+};
+
+/* exp(-lambda d^2) in the Bhattacharyya distance d between the normalized
+feature row and a reference histogram, the mean positive example tracked
+with the learning rate; needs non-negative (histogram) features */
+class bhattacharyya_likelihood {
+public:
+    static const bool refresh_features = false;
+    void fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void partial_fit(MatrixXr& training_feature_value, int n_positive, int n_negative, const TrackerConfig& config);
+    void reset_columns(MatrixXr& training_feature_value, int n_positive, int n_negative, const vector<int>& columns) {}
+    void log_likelihood(const Ref<const MatrixXr>& feature_value, VectorXr& log_likelihood);
+private:
+    VectorXr reference; /** normalized reference histogram */
+    VectorXr sqrt_reference;
+    VectorXr row_sum;
+};
+
+template<class Feature, class Likelihood>
+class feature_likelihood_model : public observation_model {
+public:
+    feature_likelihood_model(const TrackerConfig& _config) : config(_config) {}
+
+    void initialize(Mat& image, Rect& reference_roi, vector<Rect>& positive_examples, vector<Rect>& negative_examples){
+        Mat& frame = featureFrame(image);
+        feature.init(reference_roi, config.params);
+        setFrame(image, frame);
+        feature.refresh(frame, positive_examples, negative_examples, changed_columns);
+        computeTrainingFeatures(frame, positive_examples, negative_examples);
+        likelihood.fit(training_feature_value, positive_examples.size(), negative_examples.size(), config);
+    }
+
+    const VectorXr& log_likelihood(Mat& image, vector<Rect>& boxes){
+        // the buffers are reused across frames, resize is a no-op once the shape is settled
+        sample_feature_value.resize(boxes.size(), feature.size());
+        // a frame starts with scoring its particles
+        Mat& frame = featureFrame(image);
+        setFrame(image, frame);
+        feature.compute(frame, boxes, sample_feature_value);
+        likelihood.log_likelihood(sample_feature_value, log_likelihood_value);
+        return log_likelihood_value;
+    }
+
+    void update(Mat& image, Rect& reference_roi, vector<Rect>& positive_examples, vector<Rect>& negative_examples){
+        Mat& frame = featureFrame(image);
+        // the training boxes come from the frame just scored, unless called on its own
+        if(image.data != frame_data || image.size() != frame_size) setFrame(image, frame);
+        changed_columns.clear();
+        if(Likelihood::refresh_features) feature.refresh(frame, positive_examples, negative_examples, changed_columns);
+        computeTrainingFeatures(frame, positive_examples, negative_examples);
+        likelihood.partial_fit(training_feature_value, positive_examples.size(), negative_examples.size(), config);
+        // a blended update would score the new features against the old ones' statistics
+        if(!changed_columns.empty()) likelihood.reset_columns(training_feature_value, positive_examples.size(), negative_examples.size(), changed_columns);
+    }
+
+    int featureSize(){
+        return feature.size();
+    }
+
+private:
+    Mat& featureFrame(Mat& image){
+        if(Feature::color) return image;
+        cvtColor(image, grayImg, CV_RGB2GRAY);
+        return grayImg;
+    }
+    void setFrame(Mat& image, Mat& frame){
+        frame_data = image.data;
+        frame_size = image.size();
+        feature.set_frame(frame);
+    }
+    void computeTrainingFeatures(Mat& frame, vector<Rect>& positive_examples, vector<Rect>& negative_examples){
+        // positives fill the top rows and negatives the bottom rows of one buffer,
+        // in one call so the per-frame work of the feature (integral images) is done once
+        training_boxes.assign(positive_examples.begin(), positive_examples.end());
+        training_boxes.insert(training_boxes.end(), negative_examples.begin(), negative_examples.end());
+        training_feature_value.resize(training_boxes.size(), feature.size());
+        feature.compute(frame, training_boxes, training_feature_value);
+    }
+    TrackerConfig config;
+    Feature feature;
+    Likelihood likelihood;
+    MatrixXr sample_feature_value; /** one row per box */
+    MatrixXr training_feature_value; /** some likelihoods keep a pointer to it, stays dynamic */
+    VectorXr log_likelihood_value;
+    vector<Rect> training_boxes;
+    vector<int> changed_columns;
+    Mat grayImg;
+    const uchar* frame_data = NULL; /** identifies the frame last given to set_frame() */
+    Size frame_size;
+};
+
+#endif // OBSERVATION_MODEL_H
@@ -0,0 +1,95 @@
+/**
+ * @file particle.hpp
+ * @brief particle state and bounded particle history
+ * @details particle_history keeps the last lag+1 steps of a particle system
+ * in structure-of-arrays form, one particle_slice per step, inside a
+ * ring_buffer. Its memory is allocated once by reset() and stays constant
+ * however long the sequence runs.
+ */
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+#include <vector>
+#include <Eigen/Dense>
+#include "../utils/ring_buffer.hpp"
+
+using namespace std;
+using namespace Eigen;
+
+typedef struct particle {
+    float x; /** current x coordinate */
+    float y; /** current y coordinate */
+    float width; /** current width coordinate */
+    float height; /** current height coordinate */
+    float scale; /** current velocity bounding box scale */
+    float x_p; /** current x coordinate */
+    float y_p; /** current y coordinate */
+    float width_p; /** current width coordinate */
+    float height_p; /** current height coordinate */
+    float scale_p; /** current velocity bounding box scale */
+} particle;
+
+/* one time step of the particle system, one entry per particle */
+typedef struct particle_slice {
+    VectorXf x,y,width,height;
+    VectorXf x_p,y_p; /** previous position, the velocity is x - x_p */
+    VectorXf weights; /** normalized filtering weights */
+    VectorXi parents; /** index of every particle's parent in the previous slice */
+    int time_stamp;
+} particle_slice;
+
+class particle_history {
+public:
+    particle_history(){
+        n_particles=0;
+    }
+    /** room for lag+1 steps of _n_particles particles, empties the history */
+    void reset(int lag, int _n_particles){
+        n_particles=_n_particles;
+        slices.reset(lag+1);
+        for (int k=0;k<slices.capacity();k++){
+            particle_slice& slice=slices.push_back();
+            slice.x.resize(n_particles);
+            slice.y.resize(n_particles);
+            slice.width.resize(n_particles);
+            slice.height.resize(n_particles);
+            slice.x_p.resize(n_particles);
+            slice.y_p.resize(n_particles);
+            slice.weights.resize(n_particles);
+            slice.parents.resize(n_particles);
+        }
+        slices.clear();
+    }
+    void clear(){
+        slices.clear();
+    }
+    /** records a step, the oldest one is dropped once lag+1 steps are stored */
+    particle_slice& push(const vector<particle>& states, int time_stamp){
+        particle_slice& slice=slices.push_back();
+        for (int i=0;i<n_particles;i++){
+            slice.x(i)=states[i].x;
+            slice.y(i)=states[i].y;
+            slice.width(i)=states[i].width;
+            slice.height(i)=states[i].height;
+            slice.x_p(i)=states[i].x_p;
+            slice.y_p(i)=states[i].y_p;
+        }
+        slice.weights.setConstant(1.0f/n_particles);
+        slice.parents.setLinSpaced(n_particles,0,n_particles-1);
+        slice.time_stamp=time_stamp;
+        return slice;
+    }
+    /** step k, 0 is the oldest stored and size()-1 the newest */
+    particle_slice& operator[](int k){ return slices[k]; }
+    const particle_slice& operator[](int k) const { return slices[k]; }
+    particle_slice& back(){ return slices.back(); }
+    int size() const { return slices.size(); }
+    int lag() const { return slices.capacity()-1; }
+    int particles() const { return n_particles; }
+
+private:
+    ring_buffer<particle_slice> slices;
+    int n_particles;
+};
+
+#endif // PARTICLE_H
@@ -6,21 +6,7 @@
 #include "particle_filter.hpp"
 
 #ifndef PARAMS
-const float POS_STD=1.0;
-const float SCALE_STD=1.0;
 const float DT=1.0;
-const float THRESHOLD=1.0;
-const float OVERLAP_RATIO=0.8;
-
-//const bool INCREMENTAL_GAUSSIAN_NAIVEBAYES=true;
-const bool GAUSSIAN_NAIVEBAYES=true;
-const bool LOGISTIC_REGRESSION=false;
-const bool MULTINOMIAL_NAIVEBAYES=false;
-
-const bool HAAR_FEATURE=true;
-const bool LBP_FEATURE=false;
-const bool HOG_FEATURE=false;
-const bool MB_LBP_FEATURE=false;
 #endif
 
 particle_filter::particle_filter() {
@@ -31,21 +17,24 @@ particle_filter::~particle_filter() {
     weights.clear();
 }
 
-particle_filter::particle_filter(int _n_particles) {
+particle_filter::particle_filter(int _n_particles) : particle_filter(_n_particles, TrackerConfig()) {
+}
+
+particle_filter::particle_filter(int _n_particles, const TrackerConfig& _config) {
+    config = _config;
     states.clear();
     weights.clear();
     positive_likelihood.clear();
     n_particles = _n_particles;
     time_stamp=0;
+    last_smoothed=-1;
     initialized=false;
-    unsigned seed1 = std::chrono::system_clock::now().time_since_epoch().count();
-    generator.seed(seed1);
     theta_x.clear();
     RowVectorXd theta_x_pos(2);
-    theta_x_pos << POS_STD,POS_STD;
+    theta_x_pos << config.params.pos_std,config.params.pos_std;
     theta_x.push_back(theta_x_pos);
     RowVectorXd theta_x_scale(2);
-    theta_x_scale << SCALE_STD,SCALE_STD;
+    theta_x_scale << config.params.scale_std,config.params.scale_std;
     theta_x.push_back(theta_x_scale);
     eps= std::numeric_limits<double>::epsilon();
 }
@@ -59,13 +48,13 @@ void particle_filter::reinitialize() {
 }
 
 void particle_filter::initialize(Mat& current_frame, Rect ground_truth) {
-    normal_distribution<double> negative_random_pos(0.0,20.0);
-    normal_distribution<double> position_random_x(0.0,theta_x.at(0)(0));
-    normal_distribution<double> position_random_y(0.0,theta_x.at(0)(1));
-    normal_distribution<double> scale_random_width(0.0,theta_x.at(1)(0));
-    normal_distribution<double> scale_random_height(0.0,theta_x.at(1)(1));
+    PROFILE_SCOPE("particle_filter.initialize");
+    const float negative_std=20.0f;
     marginal_likelihood=0.0;
     vector<Rect> negativeBox;
+    // a reinitialization consumes a frame as predict does, so the time steps
+    // of the history keep matching frames
+    if(!estimates.empty()) time_stamp++;
     states.clear();
     weights.clear();
     estimates.clear();
@@ -84,11 +73,15 @@ void particle_filter::initialize(Mat& current_frame, Rect ground_truth) {
         reference_roi.height>0 && (reference_roi.y+reference_roi.height)<im_size.height){
         marginal_likelihood=0.0;
         float weight=log(1.0/n_particles);
+        position_noise.resize(n_particles,2);
+        generator.fill_normal(position_noise);
+        position_noise.col(0)*=theta_x.at(0)(0);
+        position_noise.col(1)*=theta_x.at(0)(1);
         for (int i=0;i<n_particles;i++){
             particle state;
             float _x,_y,_width,_height;
-            float _dx=position_random_x(generator);
-            float _dy=position_random_y(generator);
+            float _dx=position_noise(i,0);
+            float _dy=position_noise(i,1);
             //float _dw=scale_random_width(generator);
             //float _dh=scale_random_height(generator);
             _x=MIN(MAX(cvRound(reference_roi.x+_dx),0),im_size.width);
@@ -132,243 +125,60 @@ void particle_filter::initialize(Mat& current_frame, Rect ground_truth) {
             Rect box(state.x, state.y, state.width, state.height);
             sampleBox.push_back(box);   
         }
+        ancestors.resize(n_particles);
+        for (int i=0;i<n_particles;i++) ancestors[i]=i;
+        if(config.fixed_lag>0){
+            // the pending smoothed estimates of the previous track come out first
+            flush_smoother();
+            history.reset(config.fixed_lag,n_particles);
+            history.push(states,time_stamp);
+        }
+        // first proposal for every negative box comes from one batch, the
+        // rejection loop only draws scalars for the few boxes overlapping the target
+        negative_noise.resize(n_particles,2);
+        generator.fill_normal(negative_noise);
+        negative_noise*=negative_std;
         for (int i=0;i<n_particles;i++){
-            Rect box=reference_roi;
-            Rect intersection=(box & reference_roi);
-            while( double(intersection.area())/double(reference_roi.area()) > OVERLAP_RATIO ){
-                float _dx=negative_random_pos(generator);
-                float _dy=negative_random_pos(generator);
+            Rect box,intersection;
+            float _dx=negative_noise(i,0);
+            float _dy=negative_noise(i,1);
+            for(int trial=0;;trial++){
+                if(trial>0){
+                    _dx=negative_std*generator.normal();
+                    _dy=negative_std*generator.normal();
+                }
                 box.x=MIN(MAX(cvRound(reference_roi.x+_dx),0),im_size.width);
                 box.y=MIN(MAX(cvRound(reference_roi.y+_dy),0),im_size.height);
                 box.width=MIN(MAX(cvRound(reference_roi.width),0),im_size.width-box.x);
                 box.height=MIN(MAX(cvRound(reference_roi.height),0),im_size.height-box.y);
                 intersection=(box & reference_roi);
+                if(double(intersection.area())/double(reference_roi.area()) <= config.params.overlap_ratio) break;
             }
             negativeBox.push_back(box); 
         }
-        Mat grayImg;
-        cvtColor(current_frame, grayImg, CV_RGB2GRAY);
-        //equalizeHist( grayImg, grayImg );
-        haar.init(grayImg,reference_roi,sampleBox);
-
-        if(GAUSSIAN_NAIVEBAYES){
-            VectorXi labels(2*n_particles);
-            labels << VectorXi::Ones(n_particles), VectorXi::Zero(n_particles);
-            
-            if(HAAR_FEATURE){
-                MatrixXd eigen_sample_positive_feature_value, eigen_sample_negative_feature_value;
-                cv2eigen(haar.sampleFeatureValue, eigen_sample_positive_feature_value);
-                haar.getFeatureValue(grayImg,negativeBox);
-                cv2eigen(haar.sampleFeatureValue, eigen_sample_negative_feature_value);
-                MatrixXd eigen_sample_feature_value( eigen_sample_positive_feature_value.rows(),
-                    eigen_sample_positive_feature_value.cols() + eigen_sample_negative_feature_value.cols());
-                eigen_sample_feature_value <<   eigen_sample_positive_feature_value,
-                                                eigen_sample_negative_feature_value;
-                eigen_sample_feature_value.transposeInPlace();
-                gaussian_naivebayes = GaussianNaiveBayes(eigen_sample_feature_value, labels);
-                gaussian_naivebayes.fit();
-            }
-            if(LBP_FEATURE){
-                local_binary_pattern.init(grayImg, sampleBox);
-                local_binary_pattern.getFeatureValue(grayImg, negativeBox, false);
-                MatrixXd eigen_sample_feature_value(local_binary_pattern.sampleFeatureValue.rows() +
-                local_binary_pattern.negativeFeatureValue.rows(), local_binary_pattern.sampleFeatureValue.cols());
-                eigen_sample_feature_value << local_binary_pattern.sampleFeatureValue,
-                                              local_binary_pattern.negativeFeatureValue;
-                gaussian_naivebayes = GaussianNaiveBayes(eigen_sample_feature_value, labels);
-                gaussian_naivebayes.fit();
-            }
-            if(MB_LBP_FEATURE){
-                multiblock_local_binary_patterns = MultiScaleBlockLBP(3,59,2,true,false,3,3);
-                multiblock_local_binary_patterns.init(grayImg, sampleBox);
-                multiblock_local_binary_patterns.getFeatureValue(grayImg, negativeBox, false);
-                MatrixXd eigen_sample_feature_value(multiblock_local_binary_patterns.sampleFeatureValue.rows() +
-                    multiblock_local_binary_patterns.negativeFeatureValue.rows(), multiblock_local_binary_patterns.sampleFeatureValue.cols());
-                eigen_sample_feature_value << multiblock_local_binary_patterns.sampleFeatureValue,
-                                              multiblock_local_binary_patterns.negativeFeatureValue;
-                gaussian_naivebayes = GaussianNaiveBayes(eigen_sample_feature_value, labels);
-                gaussian_naivebayes.fit();
-            }
-            if(HOG_FEATURE){
-                MatrixXd hog_descriptors(0, 3780);
-                VectorXd hist;
-                for (unsigned int i = 0; i < sampleBox.size(); ++i)
-                {
-                    Mat subImage = grayImg(sampleBox.at(i));
-                    calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                    hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                    hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                }
-
-                for (unsigned int i = 0; i < negativeBox.size(); ++i)
-                {
-                    Mat subImage = grayImg(negativeBox.at(i));
-                    calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                    hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                    hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                }
-                gaussian_naivebayes = GaussianNaiveBayes(hog_descriptors, labels);
-                gaussian_naivebayes.fit();
-            }
-        }
-
-        if(LOGISTIC_REGRESSION){
-            VectorXd labels(2*n_particles);
-            labels << VectorXd::Ones(n_particles), VectorXd::Constant(n_particles,-1.0);
-            hamiltonian_monte_carlo=Hamiltonian_MC();
-            /*int num_iter=1e2;
-            double step_size=1e-3;
-            int leapgrog=10;*/ 
-            double lambda=0.1;
-            //int num_steps=10;
-            if(HAAR_FEATURE){
-                MatrixXd eigen_sample_positive_feature_value, eigen_sample_negative_feature_value;
-                cv2eigen(haar.sampleFeatureValue, eigen_sample_positive_feature_value);
-                haar.getFeatureValue(grayImg,negativeBox);
-                cv2eigen(haar.sampleFeatureValue, eigen_sample_negative_feature_value);
-                MatrixXd eigen_sample_feature_value( eigen_sample_positive_feature_value.rows(),
-                    eigen_sample_positive_feature_value.cols() + eigen_sample_negative_feature_value.cols());
-                eigen_sample_feature_value <<   eigen_sample_positive_feature_value,
-                                                eigen_sample_negative_feature_value;
-                eigen_sample_feature_value.transposeInPlace();
-                hamiltonian_monte_carlo = Hamiltonian_MC(eigen_sample_feature_value, labels,lambda);
-                hamiltonian_monte_carlo.run(1e3,1e-2,10);
-                //hamiltonian_monte_carlo.fit_map(3);
-            }
-
-            if(LBP_FEATURE){
-                //local_binary_pattern = LocalBinaryPattern();
-                local_binary_pattern.init(grayImg, sampleBox);
-                local_binary_pattern.getFeatureValue(grayImg, negativeBox, false);
-                MatrixXd eigen_sample_feature_value(local_binary_pattern.sampleFeatureValue.rows() +
-                local_binary_pattern.negativeFeatureValue.rows(), local_binary_pattern.sampleFeatureValue.cols());
-                eigen_sample_feature_value << local_binary_pattern.sampleFeatureValue,
-                                              local_binary_pattern.negativeFeatureValue;
-                hamiltonian_monte_carlo = Hamiltonian_MC(eigen_sample_feature_value, labels,lambda);
-                hamiltonian_monte_carlo.run(1e3,1e-2,10);
-            }
-
-            if(MB_LBP_FEATURE){
-                multiblock_local_binary_patterns = MultiScaleBlockLBP(3,59,2,true,false,3,3);
-                multiblock_local_binary_patterns.init(grayImg, sampleBox);
-                multiblock_local_binary_patterns.getFeatureValue(grayImg, negativeBox, false);
-                MatrixXd eigen_sample_feature_value(multiblock_local_binary_patterns.sampleFeatureValue.rows() +
-                    multiblock_local_binary_patterns.negativeFeatureValue.rows(), multiblock_local_binary_patterns.sampleFeatureValue.cols());
-                eigen_sample_feature_value << multiblock_local_binary_patterns.sampleFeatureValue,
-                                              multiblock_local_binary_patterns.negativeFeatureValue;
-                hamiltonian_monte_carlo = Hamiltonian_MC(eigen_sample_feature_value, labels,lambda);
-                hamiltonian_monte_carlo.run(1e3,1e-2,10);
-            }
-
-            if(HOG_FEATURE){
-                //MatrixXd hog_descriptors(sampleBox.size() + negativeBox.size(), 7040);
-                MatrixXd hog_descriptors(0, 3780);
-                VectorXd hist;
-                for (unsigned int i = 0; i < sampleBox.size(); ++i)
-                {
-                    Mat subImage = grayImg(sampleBox.at(i));
-                    calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                    hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                    hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                }
-
-                for (unsigned int i = 0; i < negativeBox.size(); ++i)
-                {
-                    Mat subImage = grayImg(negativeBox.at(i));
-                    calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                    hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                    hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                }
-                hamiltonian_monte_carlo = Hamiltonian_MC(hog_descriptors, labels,lambda);
-                hamiltonian_monte_carlo.run(1e3,1e-2,10);
-                //logistic_regression = LogisticRegression(eigen_sample_feature_value, labels,lambda);
-                //logistic_regression.Train(num_iter,step_size);
-            }
-            
-        }
-
-        if(MULTINOMIAL_NAIVEBAYES){
-            VectorXd labels(2*n_particles);
-            labels << VectorXd::Ones(n_particles), VectorXd::Zero(n_particles);
-            double lambda=0.1;
-            if(HAAR_FEATURE){
-                MatrixXd eigen_sample_positive_feature_value, eigen_sample_negative_feature_value;
-                cv2eigen(haar.sampleFeatureValue, eigen_sample_positive_feature_value);
-                haar.getFeatureValue(grayImg,negativeBox);
-                cv2eigen(haar.sampleFeatureValue, eigen_sample_negative_feature_value);
-                MatrixXd eigen_sample_feature_value( eigen_sample_positive_feature_value.rows(),
-                    eigen_sample_positive_feature_value.cols() + eigen_sample_negative_feature_value.cols());
-                eigen_sample_feature_value <<   eigen_sample_positive_feature_value,
-                                                eigen_sample_negative_feature_value;
-                eigen_sample_feature_value.transposeInPlace();
-                multinomial_naivebayes = MultinomialNaiveBayes(eigen_sample_feature_value, labels);
-                multinomial_naivebayes.fit(lambda);
-            }
-
-            if(LBP_FEATURE){
-                local_binary_pattern.init(grayImg, sampleBox);
-                local_binary_pattern.getFeatureValue(grayImg, negativeBox, false);
-                MatrixXd eigen_sample_feature_value(local_binary_pattern.sampleFeatureValue.rows() +
-                local_binary_pattern.negativeFeatureValue.rows(), local_binary_pattern.sampleFeatureValue.cols());
-                eigen_sample_feature_value << local_binary_pattern.sampleFeatureValue,
-                                              local_binary_pattern.negativeFeatureValue;
-                multinomial_naivebayes = MultinomialNaiveBayes(eigen_sample_feature_value, labels);
-                multinomial_naivebayes.fit(lambda);
-            }
-
-            if(MB_LBP_FEATURE){
-                multiblock_local_binary_patterns = MultiScaleBlockLBP(3,59,2,true,false,3,3);
-                multiblock_local_binary_patterns.init(grayImg, sampleBox);
-                multiblock_local_binary_patterns.getFeatureValue(grayImg, negativeBox, false);
-                MatrixXd eigen_sample_feature_value(multiblock_local_binary_patterns.sampleFeatureValue.rows() +
-                    multiblock_local_binary_patterns.negativeFeatureValue.rows(), multiblock_local_binary_patterns.sampleFeatureValue.cols());
-                eigen_sample_feature_value << multiblock_local_binary_patterns.sampleFeatureValue,
-                                              multiblock_local_binary_patterns.negativeFeatureValue;
-                multinomial_naivebayes = MultinomialNaiveBayes(eigen_sample_feature_value, labels);
-                multinomial_naivebayes.fit(lambda);
-            }
-
-            if(HOG_FEATURE){
-                MatrixXd hog_descriptors(0, 3780);
-                VectorXd hist;
-                for (unsigned int i = 0; i < sampleBox.size(); ++i)
-                {
-                    Mat subImage = grayImg(sampleBox.at(i));
-                    calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                    hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                    hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                }
-
-                for (unsigned int i = 0; i < negativeBox.size(); ++i)
-                {
-                    Mat subImage = grayImg(negativeBox.at(i));
-                    calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                    hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                    hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                }
-                multinomial_naivebayes=MultinomialNaiveBayes(hog_descriptors, labels);
-                multinomial_naivebayes.fit(lambda);
-            }
-        }
+        observation.reset(make_observation_model(config));
+        observation->initialize(current_frame, reference_roi, sampleBox, negativeBox);
         initialized=true;
     }
 }
 
 void particle_filter::predict(){
-    normal_distribution<double> position_random_x(0.0,theta_x.at(0)(0));
-    normal_distribution<double> position_random_y(0.0,theta_x.at(0)(1));
-    normal_distribution<double> scale_random_width(0.0,theta_x.at(1)(0));
-    normal_distribution<double> scale_random_height(0.0,theta_x.at(1)(1));
+    PROFILE_SCOPE("particle_filter.predict");
     sampleBox.clear();//important
     //cout << "predicted particles!" <<endl;
     if(initialized==true){
         time_stamp++;
         vector<particle> tmp_new_states(n_particles);
+        // N x 2 structure-of-arrays noise buffer, one column per coordinate
+        position_noise.resize(n_particles,2);
+        generator.fill_normal(position_noise);
+        position_noise.col(0)*=theta_x.at(0)(0);
+        position_noise.col(1)*=theta_x.at(0)(1);
         for (int i=0;i<n_particles;i++){
             particle state=states[i];
             float _x,_y,_width,_height;
-            float _dx=position_random_x(generator);
-            float _dy=position_random_y(generator);
+            float _dx=position_noise(i,0);
+            float _dy=position_noise(i,1);
             //float _dw=scale_random_width(generator);
             //float _dh=scale_random_height(generator);
             _x=MIN(MAX(cvRound(state.x),0),im_size.width);
@@ -479,165 +289,28 @@ Rect particle_filter::estimate(Mat& image,bool draw=false){
 
 void particle_filter::update(Mat& image)
 {
+    PROFILE_SCOPE("particle_filter.update");
     vector<float> tmp_weights;
     //uniform_int_distribution<int> random_feature(0,haar.featureNum-1);
-    Mat grayImg;
-    cvtColor(image, grayImg, CV_RGB2GRAY);
-    //equalizeHist( grayImg, grayImg );
-
-    if(GAUSSIAN_NAIVEBAYES){
-        //MatrixXd Phi;
-        VectorXd Phi;
-        int positive = 1;
-        if(HAAR_FEATURE){
-            haar.getFeatureValue(grayImg,sampleBox);
-            MatrixXd eigen_sample_feature_value;
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_feature_value);
-            eigen_sample_feature_value.transposeInPlace();
-            //Phi = gaussian_naivebayes.get_proba(eigen_sample_feature_value);
-            Phi = gaussian_naivebayes.predict_proba(eigen_sample_feature_value, positive);
-            //cout << "in loop" << endl;
-        }
-        //cout << "update" << endl;
-        /*for (int i = 0; i < n_particles; ++i)
-        {
-            states[i] = update_state(states[i], image);
-            tmp_weights.push_back(Phi(i,1)-Phi(i,0));
-        }*/
-        //cout << log(Phi.col(1)) << endl;
-        if(LBP_FEATURE){
-            local_binary_pattern.getFeatureValue(grayImg, sampleBox);
-            //Phi = gaussian_naivebayes.get_proba(local_binary_pattern.sampleFeatureValue);
-            Phi = gaussian_naivebayes.predict_proba(local_binary_pattern.sampleFeatureValue, positive);
-        }
-
-        if(MB_LBP_FEATURE){
-            multiblock_local_binary_patterns.getFeatureValue(grayImg, sampleBox, true);
-            //Phi = gaussian_naivebayes.get_proba(multiblock_local_binary_patterns.sampleFeatureValue);
-            Phi = gaussian_naivebayes.predict_proba(local_binary_pattern.sampleFeatureValue, positive);
-        }
-
-        if(HOG_FEATURE){
-            MatrixXd hog_descriptors(0,3780);
-            VectorXd hist;
-            for (unsigned int i = 0; i < sampleBox.size(); ++i)
-            {
-                Mat subImage = grayImg(sampleBox.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize(hog_descriptors.rows()+1, hog_descriptors.cols());
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-            }
-            //Phi = gaussian_naivebayes.get_proba(hog_descriptors);
-            Phi = gaussian_naivebayes.predict_proba(hog_descriptors, positive);
-        }
-        //cout << "update" << endl;
-        for (int i = 0; i < n_particles; ++i)
-        {
-            states[i] = update_state(states[i], image);
-            //weights[i]=Phi(i,1)-Phi(i,0);
-            weights[i]=Phi(i);
-        }
-    }
-
-    if(LOGISTIC_REGRESSION){
-        VectorXd phi;
-        
-        if(HAAR_FEATURE){
-            haar.getFeatureValue(grayImg,sampleBox);
-            MatrixXd eigen_sample_feature_value;
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_feature_value);
-            eigen_sample_feature_value.transposeInPlace();
-            phi = hamiltonian_monte_carlo.predict(eigen_sample_feature_value);
-            //phi = logistic_regression.Predict(eigen_sample_feature_value);
-            //cout << "phi: " << phi.transpose() << endl;
-        }
-
-        if(LBP_FEATURE){
-            local_binary_pattern.getFeatureValue(grayImg,sampleBox);
-            phi = hamiltonian_monte_carlo.predict(local_binary_pattern.sampleFeatureValue);
-        }
-
-        if(MB_LBP_FEATURE){
-            multiblock_local_binary_patterns.getFeatureValue(grayImg, sampleBox, true);
-            phi = hamiltonian_monte_carlo.predict(multiblock_local_binary_patterns.sampleFeatureValue);
-        }
-
-        if(HOG_FEATURE){
-            //MatrixXd hog_descriptors(sampleBox.size(),7040);
-            MatrixXd hog_descriptors(0,3780);
-            VectorXd hist;
-            for (unsigned int i = 0; i < sampleBox.size(); ++i)
-            {
-                Mat subImage = grayImg(sampleBox.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize(hog_descriptors.rows()+1, hog_descriptors.cols());
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-                //hog_descriptors.row(i) = hist;
-            }
-            phi = hamiltonian_monte_carlo.predict(hog_descriptors);
-        }
-        //double max_value=phi.maxCoeff(); 
-        //cout << phi.transpose() << ", max value: "<< max_value << ", prob: "<< max_value+log((phi.array()-max_value).exp().sum())-log(n_particles) << endl;
-        for (int i = 0; i < n_particles; ++i)
-        {
-            states[i] = update_state(states[i], image);
-            weights[i]=phi(i);
-        }
+    const VectorXr& phi = observation->log_likelihood(image, sampleBox);
+    for (int i = 0; i < n_particles; ++i)
+    {
+        states[i] = update_state(states[i], image);
+        weights[i]=phi(i);
     }
-
-    if(MULTINOMIAL_NAIVEBAYES){
-        MatrixXd Phi;
-        if(HAAR_FEATURE){
-            haar.getFeatureValue(grayImg,sampleBox);
-            MatrixXd eigen_sample_feature_value;
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_feature_value);
-            eigen_sample_feature_value.transposeInPlace();
-            Phi = multinomial_naivebayes.get_proba(eigen_sample_feature_value);
-            //cout << "in loop" << endl;
-        }
-
-        if(LBP_FEATURE){
-            local_binary_pattern.getFeatureValue(grayImg, sampleBox);
-            Phi = multinomial_naivebayes.get_proba(local_binary_pattern.sampleFeatureValue);
-        }
-
-        if(MB_LBP_FEATURE){
-            multiblock_local_binary_patterns.getFeatureValue(grayImg, sampleBox, true);
-            Phi = multinomial_naivebayes.get_proba(multiblock_local_binary_patterns.sampleFeatureValue);
-        }
-
-        if(HOG_FEATURE){
-            MatrixXd hog_descriptors(0,3780);
-            VectorXd hist;
-            for (unsigned int i = 0; i < sampleBox.size(); ++i)
-            {
-                Mat subImage = grayImg(sampleBox.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize(hog_descriptors.rows()+1, hog_descriptors.cols());
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-            }
-            Phi = multinomial_naivebayes.get_proba(hog_descriptors);
-        }
-        //cout << "update" << endl;
-        for (int i = 0; i < n_particles; ++i)
-        {
-            states[i] = update_state(states[i], image);
-            weights[i]=(Phi(i,1)-Phi(i,0));
-        }
-        //cout << log(Phi.col(1)) << endl;
-    }
-
     //weights.swap(tmp_weights);
     tmp_weights.clear();
+    PROFILE_COUNT("likelihood_evaluations",n_particles);
     resample();
+    if(config.fixed_lag>0 && history.size()==history.lag()+1) smoother(config.fixed_lag);
 
 }
 
 float particle_filter::resample(){
+    PROFILE_SCOPE("particle_filter.resample");
     vector<float> cumulative_sum(n_particles);
     vector<float> normalized_weights(n_particles);
     vector<float> squared_normalized_weights(n_particles);
-    uniform_real_distribution<float> unif_rnd(0.0,1.0); 
     float max_value = *max_element(weights.begin(), weights.end());
     float logsumexp=0.0f;
     for (int i=0; i<n_particles; i++) {
@@ -660,16 +333,27 @@ float particle_filter::resample(){
     Scalar sum_squared_weights=sum(squared_normalized_weights);
     marginal_likelihood+=max_value+log(sum_weights[0])-log(n_particles); 
     ESS=1/sum_squared_weights[0]/n_particles;
+    PROFILE_GAUGE("particle_filter_ess",ESS);
+    if(history.lag()>0){
+        particle_slice& slice=history.push(states,time_stamp);
+        for (int i=0; i<n_particles; i++){
+            slice.weights(i)=normalized_weights.at(i);
+            slice.parents(i)=ancestors[i];
+        }
+    }
     //cout  << "ESS :" << ESS << ",marginal_likelihood :" << marginal_likelihood <<  endl;
     //cout << "resampled particles!" << ESS << endl;
-    if(isless(ESS,(float)THRESHOLD)){
+    if(isless(ESS,config.params.threshold)){
+        PROFILE_COUNT("resample_events",1);
         vector<particle> new_states(n_particles);
+#ifdef TRACKER_RESAMPLER
+        TRACKER_RESAMPLER::resample(cumulative_sum, generator, ancestors);
+#else
+        if(config.resampler==RESAMPLER_SYSTEMATIC) systematic_resampler::resample(cumulative_sum, generator, ancestors);
+        else multinomial_resampler::resample(cumulative_sum, generator, ancestors);
+#endif
         for (int i=0; i<n_particles; i++) {
-            float uni_rand = unif_rnd(generator);
-            vector<float>::iterator pos = lower_bound(cumulative_sum.begin(), cumulative_sum.end(), uni_rand);
-            unsigned int ipos = distance(cumulative_sum.begin(), pos);
-            
-            particle state=states[ipos];
+            particle state=states[ancestors[i]];
             
             //cout << "x:" << state.x << ",y:" << state.y <<",w:" << state.width <<",h:" << state.height << endl;
             new_states[i]=state;
@@ -679,7 +363,7 @@ float particle_filter::resample(){
         new_states = vector<particle>();
     }
     else{
-        //weights.swap(log_normalized_weights);
+        for (int i=0; i<n_particles; i++) ancestors[i]=i;
     }
     cumulative_sum.clear();
     normalized_weights.clear();
@@ -700,126 +384,44 @@ void particle_filter::update_model(vector<VectorXd> theta_x_new){
 }
 
 void particle_filter::update_model(Mat& current_frame,vector<Rect> positive_examples,vector<Rect> negative_examples){
-    Mat grayImg;
-    cvtColor(current_frame, grayImg, CV_RGB2GRAY);
-    if(LOGISTIC_REGRESSION){
-        VectorXd labels(positive_examples.size()+negative_examples.size());
-        labels << VectorXd::Ones(positive_examples.size()), VectorXd::Constant(negative_examples.size(),-1.0);
-        if(HAAR_FEATURE){
-            MatrixXd eigen_sample_positive_feature_value, eigen_sample_negative_feature_value;
-            haar.getFeatureValue(grayImg,positive_examples);
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_positive_feature_value);
-            haar.getFeatureValue(grayImg,negative_examples);
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_negative_feature_value);
-            MatrixXd eigen_sample_feature_value( eigen_sample_positive_feature_value.rows(),
-                eigen_sample_positive_feature_value.cols() + eigen_sample_negative_feature_value.cols());
-            eigen_sample_feature_value <<   eigen_sample_positive_feature_value,
-                                            eigen_sample_negative_feature_value;
-            eigen_sample_feature_value.transposeInPlace();
-            hamiltonian_monte_carlo.setData(eigen_sample_feature_value, labels);
-        }
-
-        if(LBP_FEATURE){
-            local_binary_pattern.init(grayImg, positive_examples);
-            local_binary_pattern.getFeatureValue(grayImg, negative_examples, false);
-            MatrixXd eigen_sample_feature_value(local_binary_pattern.sampleFeatureValue.rows() +
-            local_binary_pattern.negativeFeatureValue.rows(), local_binary_pattern.sampleFeatureValue.cols());
-            eigen_sample_feature_value << local_binary_pattern.sampleFeatureValue,
-                                          local_binary_pattern.negativeFeatureValue;
-            hamiltonian_monte_carlo.setData(eigen_sample_feature_value, labels);
-        }
-
-        if(MB_LBP_FEATURE){
-            multiblock_local_binary_patterns = MultiScaleBlockLBP(3,59,2,true,false,3,3);
-            multiblock_local_binary_patterns.init(grayImg, positive_examples);
-            multiblock_local_binary_patterns.getFeatureValue(grayImg, negative_examples, false);
-            MatrixXd eigen_sample_feature_value(multiblock_local_binary_patterns.sampleFeatureValue.rows() +
-                multiblock_local_binary_patterns.negativeFeatureValue.rows(), multiblock_local_binary_patterns.sampleFeatureValue.cols());
-            eigen_sample_feature_value << multiblock_local_binary_patterns.sampleFeatureValue,
-                                          multiblock_local_binary_patterns.negativeFeatureValue;
-            hamiltonian_monte_carlo.setData(eigen_sample_feature_value, labels);
-        }
-
-        if(HOG_FEATURE){
-            MatrixXd hog_descriptors(0, 3780);
-            VectorXd hist;
-            for (unsigned int i = 0; i < positive_examples.size(); ++i)
-            {
-                Mat subImage = grayImg(positive_examples.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-            }
+    PROFILE_SCOPE("particle_filter.update_model");
+    observation->update(current_frame, reference_roi, positive_examples, negative_examples);
+}
 
-            for (unsigned int i = 0; i < negative_examples.size(); ++i)
-            {
-                Mat subImage = grayImg(negative_examples.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-            }
-            hamiltonian_monte_carlo.setData(hog_descriptors, labels);
-        }
+/* Path-based fixed-lag smoothing: every particle of the newest step is traced
+back through its parents, and its filtering weight goes to its ancestor
+fixed_lag steps earlier. O(N*fixed_lag), no transition density is evaluated. */
+void particle_filter::smoother(int fixed_lag){
+    PROFILE_SCOPE("particle_filter.smoother");
+    int last=history.size()-1;
+    if(fixed_lag<0 || fixed_lag>last) return;
+    const particle_slice& newest=history[last];
+    const particle_slice& smoothed=history[last-fixed_lag];
+    VectorXi index=VectorXi::LinSpaced(n_particles,0,n_particles-1);
+    for (int k=last;k>last-fixed_lag;--k){
+        const VectorXi& parents=history[k].parents;
+        for (int i=0;i<n_particles;i++) index(i)=parents(index(i));
     }
-    if(GAUSSIAN_NAIVEBAYES){
-        VectorXi labels(positive_examples.size()+negative_examples.size());
-        labels << VectorXi::Ones(positive_examples.size()), VectorXi::Zero(negative_examples.size());
-        double learning_rate = 0.2;
-        if(HAAR_FEATURE){
-            haar.init(grayImg,reference_roi,positive_examples);
-            MatrixXd eigen_sample_positive_feature_value, eigen_sample_negative_feature_value;
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_positive_feature_value);
-            haar.getFeatureValue(grayImg,negative_examples);
-            cv2eigen(haar.sampleFeatureValue, eigen_sample_negative_feature_value);
-            MatrixXd eigen_sample_feature_value( eigen_sample_positive_feature_value.rows(),
-                eigen_sample_positive_feature_value.cols() + eigen_sample_negative_feature_value.cols());
-            eigen_sample_feature_value <<   eigen_sample_positive_feature_value,
-                                            eigen_sample_negative_feature_value;
-            eigen_sample_feature_value.transposeInPlace();
-            gaussian_naivebayes.partial_fit(eigen_sample_feature_value, labels, learning_rate);
-        }
-        if(LBP_FEATURE){
-            local_binary_pattern.init(grayImg, positive_examples);
-            local_binary_pattern.getFeatureValue(grayImg, negative_examples, false);
-            MatrixXd eigen_sample_feature_value(local_binary_pattern.sampleFeatureValue.rows() +
-            local_binary_pattern.negativeFeatureValue.rows(), local_binary_pattern.sampleFeatureValue.cols());
-            eigen_sample_feature_value << local_binary_pattern.sampleFeatureValue,
-                                          local_binary_pattern.negativeFeatureValue;
-            gaussian_naivebayes.partial_fit(eigen_sample_feature_value, labels, learning_rate);
-        }
-        if(MB_LBP_FEATURE){
-            multiblock_local_binary_patterns = MultiScaleBlockLBP(3,59,2,true,false,3,3);
-            multiblock_local_binary_patterns.init(grayImg, positive_examples);
-            multiblock_local_binary_patterns.getFeatureValue(grayImg, negative_examples, false);
-            MatrixXd eigen_sample_feature_value(multiblock_local_binary_patterns.sampleFeatureValue.rows() +
-                multiblock_local_binary_patterns.negativeFeatureValue.rows(), multiblock_local_binary_patterns.sampleFeatureValue.cols());
-            eigen_sample_feature_value << multiblock_local_binary_patterns.sampleFeatureValue,
-                                          multiblock_local_binary_patterns.negativeFeatureValue;
-            gaussian_naivebayes.partial_fit(eigen_sample_feature_value, labels, learning_rate);
-        }
-        if(HOG_FEATURE){
-            MatrixXd hog_descriptors(0, 3780);
-            VectorXd hist;
-            for (unsigned int i = 0; i < positive_examples.size(); ++i)
-            {
-                Mat subImage = grayImg(positive_examples.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-            }
-
-            for (unsigned int i = 0; i < negative_examples.size(); ++i)
-            {
-                Mat subImage = grayImg(negative_examples.at(i));
-                calc_hog(subImage, hist,Size(reference_roi.width,reference_roi.height));
-                hog_descriptors.conservativeResize( hog_descriptors.rows()+1, hog_descriptors.cols() );
-                hog_descriptors.row(hog_descriptors.rows()-1) = hist;
-            }
-            gaussian_naivebayes.partial_fit(hog_descriptors, labels, learning_rate);
-        }
+    VectorXf smoothing_weights=VectorXf::Zero(n_particles);
+    for (int i=0;i<n_particles;i++) smoothing_weights(index(i))+=newest.weights(i);
+    Rect estimate(cvRound(smoothing_weights.dot(smoothed.x)),cvRound(smoothing_weights.dot(smoothed.y)),
+        cvRound(smoothing_weights.dot(smoothed.width)),cvRound(smoothing_weights.dot(smoothed.height)));
+    smoothed_estimates.push_back(estimate);
+    smoothed_frames.push_back(smoothed.time_stamp);
+    last_smoothed=smoothed.time_stamp;
+}
 
+/* smoothed estimates of the steps still inside the lag window, each with all
+the steps that follow it, e.g. at the end of a sequence */
+void particle_filter::flush_smoother(){
+    int last=history.size()-1;
+    for (int k=0;k<=last;k++){
+        if(history[k].time_stamp>last_smoothed) smoother(last-k);
     }
+}
 
+int particle_filter::featureSize(){
+    return observation ? observation->featureSize() : 0;
 }
 
 vector<VectorXd> particle_filter::get_dynamic_model(){
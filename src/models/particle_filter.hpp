@@ -14,41 +14,23 @@
 #include <chrono>
 #include <fftw3.h>
 
-#include "../features/haar.hpp"
+#include <memory>
+
 #include "../likelihood/gaussian.hpp"
-#include "../features/mb_lbp.hpp"
-#include "../likelihood/logistic_regression.hpp"
-#include "../likelihood/hamiltonian_monte_carlo.hpp"
-//#include "../likelihood/gaussian_naivebayes.hpp"
-#include "../likelihood/multinomialnaivebayes.hpp"
-#include "../likelihood/incremental_gaussiannaivebayes.hpp"
-//#include "../likelihood/weighted_gaussiannaivebayes.hpp"
-#include "../features/local_binary_pattern.hpp"
-#include "../features/hog.hpp"
+#include "observation_model.hpp"
+#include "particle.hpp"
+#include "resampler.hpp"
+#include "../utils/profiler.hpp"
+#include "../utils/random.hpp"
+#include "../utils/tracker_config.hpp"
 
-extern const float POS_STD; 
 extern const float VEL_STD; 
-extern const float SCALE_STD; 
 extern const float  DT; 
-extern const float  THRESHOLD; 
 
 using namespace cv;
 using namespace std;
 using namespace Eigen;
 
-typedef struct particle {
-    float x; /** current x coordinate */
-    float y; /** current y coordinate */
-    float width; /** current width coordinate */
-    float height; /** current height coordinate */
-    float scale; /** current velocity bounding box scale */
-    float x_p; /** current x coordinate */
-    float y_p; /** current y coordinate */
-    float width_p; /** current width coordinate */
-    float height_p; /** current height coordinate */
-    float scale_p; /** current velocity bounding box scale */
-} particle;
-
 class particle_filter {
 public:
     int n_particles;
@@ -56,6 +38,7 @@ public:
     vector<float>  weights;
     ~particle_filter();
     particle_filter(int _n_particles);
+    particle_filter(int _n_particles, const TrackerConfig& _config);
     particle_filter();
     int time_stamp;
     bool is_initialized();
@@ -74,30 +57,32 @@ public:
     float getMarginalLikelihood();
     float resample();
     vector<Rect> estimates;
+    vector<Rect> smoothed_estimates; /** fixed-lag smoothed estimates, config.fixed_lag frames behind */
+    vector<int> smoothed_frames; /** time step of every smoothed estimate */
+    void flush_smoother();
+    particle_history history; /** last config.fixed_lag+1 filtering distributions */
     particle update_state(particle state, Mat& image);
-    Haar haar;
+    int featureSize();
 
 protected:
+    TrackerConfig config;
+    unique_ptr<observation_model> observation;
     float marginal_likelihood;
     vector<VectorXd> theta_x;
     vector<VectorXd> theta_y;
     vector<Gaussian> positive_likelihood,negative_likelihood;
     float ESS;
     bool initialized;
-    mt19937 generator;
+    RandomStream generator;
+    MatrixXf position_noise,negative_noise;
     Rect reference_roi;
     Size im_size;
     Mat reference_hist;
     normal_distribution<double> position_random_walk,velocity_random_walk,scale_random_walk;
     double eps;
     vector<Rect > sampleBox;
-    LocalBinaryPattern local_binary_pattern;
-    MultiScaleBlockLBP multiblock_local_binary_patterns;
-    LogisticRegression logistic_regression;
-    MultinomialNaiveBayes multinomial_naivebayes;
-    GaussianNaiveBayes gaussian_naivebayes;
-    Hamiltonian_MC hamiltonian_monte_carlo;
-    //IncrementalGaussianNaiveBayes incremental_gaussian_naivebayes;
+    vector<int> ancestors; /** resampling parent of every particle, identity when not resampled */
+    int last_smoothed;
 };
 
 #endif
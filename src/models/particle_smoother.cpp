@@ -6,6 +6,7 @@
 #include "particle_smoother.hpp"
 
 const float POS_STD=1.0;
+const float VEL_STD=1.0;
 const float SCALE_STD=1.0;
 const float  DT=1.0;
 const float  SIGMA_COLOR=0.1;
@@ -17,55 +18,195 @@ const int POISSON_LIKELIHOOD=2;
 const int LIKELIHOOD=MULTINOMIAL_LIKELIHOOD;
 const bool HOG=true;
 
-particle_smoother::particle_smoother(int _n_particles) {
+particle_smoother::particle_smoother(int _n_particles,int _max_lag) {
     n_particles = _n_particles;
+    history.reset(_max_lag,n_particles);
     time_stamp=0;
+    ESS=0.0f;
     initialized=false;
     //rng(0xFFFFFFFF);
 }
 
+bool particle_smoother::is_initialized(){
+    return initialized;
+}
+
+void particle_smoother::initialize(Mat& current_frame, Rect ground_truth){
+    im_size=current_frame.size();
+    reference_roi=ground_truth;
+    Mat reference_image=current_frame(reference_roi);
+    calc_hist_hsv(reference_image,reference_hist);
+    if(HOG) calc_hog(reference_image,reference_hog);
+    color_lilekihood=Gaussian(0.0,SIGMA_COLOR);
+    hog_likelihood=Gaussian(0.0,SIGMA_SHAPE);
+    states.resize(n_particles);
+    for (int i=0;i<n_particles;i++){
+        particle& state=states[i];
+        state.width=reference_roi.width;
+        state.height=reference_roi.height;
+        state.x=MIN(MAX(reference_roi.x+POS_STD*generator.normal(),0.0),im_size.width-state.width);
+        state.y=MIN(MAX(reference_roi.y+POS_STD*generator.normal(),0.0),im_size.height-state.height);
+        state.x_p=state.x;
+        state.y_p=state.y;
+        state.scale=state.scale_p=1.0f;
+        state.width_p=state.width;
+        state.height_p=state.height;
+    }
+    time_stamp=0;
+    history.reset(history.lag(),n_particles);
+    history.push(states,time_stamp);
+    ESS=n_particles;
+    initialized=true;
+}
+
+/* nearly constant velocity move of the newest particles: the velocity
+v = x - x_p is part of the state and takes a VEL_STD random walk step, the
+position moves by DT*v plus POS_STD noise. The step is recorded in the history
+with the filtering weights of the previous one until update() */
+void particle_smoother::predict(){
+    if(history.size()==0){
+        cout << "Error: particle smoother not initialized" << endl;
+        return;
+    }
+    const particle_slice& newest=history.back();
+    for (int i=0;i<n_particles;i++){
+        particle& state=states[i];
+        state.width=newest.width(i);
+        state.height=newest.height(i);
+        float vx=newest.x(i)-newest.x_p(i)+VEL_STD*generator.normal();
+        float vy=newest.y(i)-newest.y_p(i)+VEL_STD*generator.normal();
+        state.x=MIN(MAX(newest.x(i)+DT*vx+POS_STD*generator.normal(),0.0),im_size.width-state.width);
+        state.y=MIN(MAX(newest.y(i)+DT*vy+POS_STD*generator.normal(),0.0),im_size.height-state.height);
+        state.x_p=state.x-vx;
+        state.y_p=state.y-vy;
+    }
+    // the states were copied out first, push may recycle the slot of newest
+    VectorXf weights=newest.weights;
+    time_stamp++;
+    particle_slice& slice=history.push(states,time_stamp);
+    slice.weights=weights;
+}
+
+const float LAMBDA_POS=0.5f/(POS_STD*POS_STD);
+const float LAMBDA_VEL=0.5f/(VEL_STD*VEL_STD);
+const int MAX_REJECTIONS=10;
+
+/* minus the log transition density, up to its normalizing constant, of the
+move of predict() from particle l of past to particle j of current. Both the
+velocity and the position terms are Gaussian, so every ancestor keeps a
+positive backward probability */
+static inline float transition_energy(const particle_slice& current, int j, const particle_slice& past, int l){
+    float vx=current.x(j)-current.x_p(j);
+    float vy=current.y(j)-current.y_p(j);
+    float dvx=vx-(past.x(l)-past.x_p(l));
+    float dvy=vy-(past.y(l)-past.y_p(l));
+    float dx=current.x(j)-past.x(l)-DT*vx;
+    float dy=current.y(j)-past.y(l)-DT*vy;
+    return LAMBDA_VEL*(dvx*dvx+dvy*dvy)+LAMBDA_POS*(dx*dx+dy*dy);
+}
+
+static inline int sample_index(const vector<float>& cumulative_sum, RandomStream& stream){
+    float uni_rand=stream.uniform();
+    vector<float>::const_iterator pos=lower_bound(cumulative_sum.begin(), cumulative_sum.end(), uni_rand);
+    return min((int)distance(cumulative_sum.begin(), pos), (int)cumulative_sum.size()-1);
+}
+
+/* Forward filtering backward simulation (Godsill, Doucet & West 2004), one
+backward trajectory per particle. The transition density is bounded by its
+normalizing constant, so the backward kernel is sampled by drawing ancestors
+from the filtering weights and accepting them with probability
+exp(-transition_energy) (Douc et al. 2011): O(N) expected work per step instead
+of O(N^2). A trajectory rejected MAX_REJECTIONS times draws from the exact
+kernel instead. smoothing_weights is the fraction of trajectories through each
+particle fixed_lag steps before the newest one in the history. */
 void particle_smoother::smoother(int fixed_lag){
-    smoothing_weights=weights.front();
-    vector<float> log_backward_probability(n_particles,0.0f);
-    vector<float> normalized_weights(n_particles,0.0f);
-    vector<float> sum_weights(n_particles,0.0f);
-    static const float LAMBDA_POS = 0.5f*1.0f/(pow(POS_STD,2.0f));
-    //cout << "------------------" << endl;
-    if(fixed_lag<time_stamp){
-        for(int k=time_stamp;k>(time_stamp-fixed_lag);--k){
-            for (int j=0;j<n_particles;j++){
-                particle state=states[k][j];
+    PROFILE_SCOPE("particle_smoother.smoother");
+    if(history.size()==0){
+        smoothing_weights.clear();
+        return;
+    }
+    int last=history.size()-1;
+    if(fixed_lag<=0 || fixed_lag>last){
+        const VectorXf& filtering_weights=history[max(last-fixed_lag,0)].weights;
+        smoothing_weights.assign(filtering_weights.data(),filtering_weights.data()+n_particles);
+        return;
+    }
+    int first=last-fixed_lag;
+    vector< vector<float> > cumulative_sum(fixed_lag+1);
+    for (int k=first;k<=last;k++){
+        vector<float>& cumulative=cumulative_sum[k-first];
+        cumulative.resize(n_particles);
+        partial_sum(history[k].weights.data(), history[k].weights.data()+n_particles, cumulative.begin());
+        float total=cumulative.back();
+        for (int i=0;i<n_particles;i++) cumulative[i]/=total;
+    }
+    vector<int> smoothed_index(n_particles);
+    long fallbacks=0;
+    #pragma omp parallel for reduction(+:fallbacks)
+    for (int m=0;m<n_particles;m++){
+        RandomStream stream=generator.split((uint64_t)history[last].time_stamp*n_particles+m);
+        vector<float> log_backward_probability;
+        int j=sample_index(cumulative_sum.back(), stream);
+        for(int k=last;k>first;--k){
+            const particle_slice& current=history[k];
+            const particle_slice& past=history[k-1];
+            int i=-1;
+            for (int attempt=0;attempt<MAX_REJECTIONS && i<0;attempt++){
+                int candidate=sample_index(cumulative_sum[k-1-first], stream);
+                if(stream.uniform()<exp(-transition_energy(current, j, past, candidate))) i=candidate;
+            }
+            if(i<0){
+                fallbacks++;
+                log_backward_probability.resize(n_particles);
                 for (int l=0;l<n_particles;l++){
-                    particle past_state=states[k-1][l];
-                    float sum=LAMBDA_POS*pow(state.x-past_state.x-past_state.dx,2.0);
-                    sum+=LAMBDA_POS*pow(state.y-past_state.y-past_state.dy,2.0);
-                    log_backward_probability[l] = log(weights[k-1].at(l))-log(2.0f*M_PI)-2.0f*log(POS_STD)-sum;
+                    log_backward_probability[l]=log(past.weights(l))-transition_energy(current, j, past, l);
                 }
-                float logsumexp=0.0f;
-                float max_value = *max_element(log_backward_probability.begin(), log_backward_probability.end());
-                for (unsigned int h=0; h<log_backward_probability.size(); h++) {
-                    logsumexp+=exp(log_backward_probability[h]-max_value);
+                float max_value=*max_element(log_backward_probability.begin(), log_backward_probability.end());
+                for (int l=0;l<n_particles;l++){
+                    log_backward_probability[l]=exp(log_backward_probability[l]-max_value);
                 }
-                sum_weights[j]=max_value+log(logsumexp);
+                partial_sum(log_backward_probability.begin(), log_backward_probability.end(), log_backward_probability.begin());
+                float uni_rand=stream.uniform()*log_backward_probability.back();
+                vector<float>::iterator pos=lower_bound(log_backward_probability.begin(), log_backward_probability.end(), uni_rand);
+                i=min((int)distance(log_backward_probability.begin(), pos), n_particles-1);
             }
-            
-            for (int i=0;i<n_particles;i++){
-                particle past_state=states[k-1][i];
-                double backward_probability=0.0f;
-                for (int j=0;j<n_particles;j++){
-                    particle state=states[k][j];
-                    float sum=LAMBDA_POS*pow(state.x-past_state.x-past_state.dx,2.0);
-                    sum+=LAMBDA_POS*pow(state.y-past_state.y-past_state.dy,2.0);
-                    float log_prob=log(weights[k-1].at(i))-log(2.0f*M_PI)-2.0f*log(POS_STD)-sum;
-                    backward_probability+=exp(log_prob-sum_weights[j]);
-                }
-                smoothing_weights.at(i) = weights[k-1].at(i)*backward_probability;
-                //cout << backward_probability << endl;
-                //smoothing_weights.at(i) = weights[k-1].at(i);
+            j=i;
+        }
+        smoothed_index[m]=j;
+    }
+    PROFILE_COUNT("smoother_exact_backward_kernels",fallbacks);
+    smoothing_weights.assign(n_particles,0.0f);
+    for (int m=0;m<n_particles;m++) smoothing_weights[smoothed_index[m]]+=1.0f/n_particles;
+}
 
+/* Marginals of the FFBSi backward kernel computed exactly, O(N^2) per step:
+w(k|T)(l) = w(k)(l) sum_j w(k+1|T)(j) f(j|l) / sum_l' w(k)(l') f(j|l'). It is
+the expectation of the smoothing_weights of smoother(), kept as a reference
+to check the rejection sampler against */
+void particle_smoother::exact_smoother(int fixed_lag){
+    if(history.size()==0){
+        smoothing_weights.clear();
+        return;
+    }
+    int last=history.size()-1;
+    int first=max(last-fixed_lag,0);
+    VectorXd smoothed=history[last].weights.cast<double>();
+    smoothed/=smoothed.sum();
+    MatrixXd kernel(n_particles,n_particles);
+    for(int k=last;k>first;--k){
+        const particle_slice& current=history[k];
+        const particle_slice& past=history[k-1];
+        VectorXd past_weights=past.weights.cast<double>();
+        for (int j=0;j<n_particles;j++){
+            for (int l=0;l<n_particles;l++){
+                kernel(j,l)=past_weights(l)*exp(-(double)transition_energy(current, j, past, l));
             }
+            kernel.row(j)/=kernel.row(j).sum();
         }
+        smoothed=kernel.transpose()*smoothed;
     }
+    smoothing_weights.resize(n_particles);
+    for (int i=0;i<n_particles;i++) smoothing_weights[i]=smoothed(i);
 }
 
 
@@ -74,12 +215,13 @@ Rect particle_smoother::smoothed_estimate(int fixed_lag){
     //smoothing_weights=weights.front();
     float _x=0.0,_y=0.0,_width=0.0,_height=0.0;
     Rect estimate;
+    if(history.size()==0 || (int)smoothing_weights.size()!=n_particles) return estimate;
+    const particle_slice& slice=history[max(history.size()-1-fixed_lag,0)];
     for (int i=0;i<n_particles;i++){
-        particle state=states[time_stamp-fixed_lag][i];
-        _x+=smoothing_weights[i]*state.x;
-        _y+=smoothing_weights[i]*state.y;
-        _width+=smoothing_weights[i]*state.width;
-        _height+=smoothing_weights[i]*state.height;
+        _x+=smoothing_weights[i]*slice.x(i);
+        _y+=smoothing_weights[i]*slice.y(i);
+        _width+=smoothing_weights[i]*slice.width(i);
+        _height+=smoothing_weights[i]*slice.height(i);
     }
     Point pt1,pt2;
     pt1.x=cvRound(_x);
@@ -90,28 +232,31 @@ Rect particle_smoother::smoothed_estimate(int fixed_lag){
         estimate=Rect(pt1.x,pt1.y,cvRound(pt2.x-pt1.x),cvRound(pt2.y-pt1.y));
     }
     else{
-        cout << "oops!" << endl;
+        cout << "Error: smoothed estimate outside the image" << endl;
     }
     return estimate;
 }
 
 
-void particle_smoother::update(Mat& image,Mat& fgmask,bool hog=false)
+void particle_smoother::update(Mat& image,bool hog)
 {
-    vector<float> tmp_weights;
+    if(history.size()<2){
+        cout << "Error: particle smoother update without predict" << endl;
+        return;
+    }
+    particle_slice& current=history.back();
+    const particle_slice& previous=history[history.size()-2];
     for (int i=0;i<n_particles;i++){
         Mat part_hist,part_roi,part_hog;
-        particle state=states[time_stamp][i];
-        Rect boundingBox=Rect(cvRound(state.x),cvRound(state.y),cvRound(state.width),cvRound(state.height));
+        Rect boundingBox=Rect(cvRound(current.x(i)),cvRound(current.y(i)),cvRound(current.width(i)),cvRound(current.height(i)));
         part_roi=image(boundingBox);
-        Mat roi_mask = Mat(fgmask,boundingBox);
         calc_hist_hsv(part_roi,part_hist);
         double bc_color = compareHist(reference_hist, part_hist, HISTCMP_BHATTACHARYYA);
         double prob = 0.0f;
         if(bc_color != 1.0f ){
             prob = color_lilekihood.likelihood(bc_color);
         }
-        float weight=weights[time_stamp-1][i]*prob;
+        float weight=previous.weights(i)*prob;
         if(hog){
             calc_hog(part_roi,part_hog);
             if(part_hog.size()==reference_hog.size()){
@@ -120,10 +265,35 @@ void particle_smoother::update(Mat& image,Mat& fgmask,bool hog=false)
                 weight*=prob_hog;
             }
         }
-        tmp_weights.push_back(weight);
+        current.weights(i)=weight;
+    }
+    float total=current.weights.sum();
+    if(total>0.0f) current.weights/=total;
+    else current.weights.setConstant(1.0f/n_particles);
+    ESS=1.0f/current.weights.squaredNorm();
+    if(ESS<THRESHOLD*n_particles) resample();
+}
+
+/* systematic resampling of the newest step in place, parents records the
+ancestors so the history stays a valid genealogy */
+void particle_smoother::resample(){
+    particle_slice& current=history.back();
+    cumulative_sum.resize(n_particles);
+    partial_sum(current.weights.data(), current.weights.data()+n_particles, cumulative_sum.begin());
+    systematic_resampler::resample(cumulative_sum, generator, ancestors);
+    particle_slice resampled=current;
+    for (int i=0;i<n_particles;i++){
+        int a=ancestors[i];
+        resampled.x(i)=current.x(a);
+        resampled.y(i)=current.y(a);
+        resampled.width(i)=current.width(a);
+        resampled.height(i)=current.height(a);
+        resampled.x_p(i)=current.x_p(a);
+        resampled.y_p(i)=current.y_p(a);
+        resampled.parents(i)=current.parents(a);
     }
-    weights.push_back(tmp_weights);
-    resample(false);
+    resampled.weights.setConstant(1.0f/n_particles);
+    current=resampled;
 }
 
 float particle_smoother::getESS(){
@@ -6,53 +6,55 @@
 #include <opencv2/highgui.hpp>
 #include <Eigen/Dense>
 #include <opencv2/core/eigen.hpp>
-#include "../likelihood/hist.hpp"
+#include "../features/hist.hpp"
+#include "../features/hog.hpp"
 #include "../likelihood/dirichlet.hpp"
 #include "../likelihood/gaussian.hpp"
+#include "../utils/random.hpp"
+#include "../utils/profiler.hpp"
+#include "particle.hpp"
+#include "resampler.hpp"
 #include <time.h>
 #include <float.h>
 #include <vector>
 #include <iostream>
+#include <numeric>
+#include <algorithm>
 
 
 
 using namespace cv;
 using namespace std;
 
-typedef struct particle {
-    float x; /** current x coordinate */
-    float y; /** current y coordinate */
-    float width; /** current width coordinate */
-    float height; /** current height coordinate */
-    float scale; /** current velocity bounding box scale */
-    float x_p; /** current x coordinate */
-    float y_p; /** current y coordinate */
-    float width_p; /** current width coordinate */
-    float height_p; /** current height coordinate */
-    float scale_p; /** current velocity bounding box scale */
-    
-} particle;
 
 
 class particle_smoother {
 public:
     int n_particles;
-    vector< vector<particle> > states;
-    vector< vector<float> >  weights;
+    particle_history history; /** last max_lag+1 filtering distributions */
     vector<float>  smoothing_weights;
-    particle_smoother(int _n_particles);
+    particle_smoother(int _n_particles,int _max_lag=10);
     particle_smoother(int _n_particles,VectorXd alpha);
+    bool is_initialized();
+    void initialize(Mat& current_frame, Rect ground_truth);
+    void predict();
+    void update(Mat& image,bool hog=false);
     Rect smoothed_estimate(int fixed_lag);
     void smoother(int fixed_lag);
+    void exact_smoother(int fixed_lag);
     void update_model(Mat& previous_frame,Mat& fgmask,Rect& smoothed_estimate);
     float getESS();
     
 
 private:
+    void resample();
     int time_stamp;
     float ESS;
+    vector<particle> states; /** workspace of predict() */
+    vector<float> cumulative_sum;
+    vector<int> ancestors;
     bool initialized;
-    RNG rng;
+    RandomStream generator;
     Rect reference_roi;
     Size im_size;
     VectorXd theta_x,theta_y;
@@ -8,8 +8,6 @@ const float PRIOR_SD=0.01;
 
 
 pmmh::pmmh(int _n_particles,int _fixed_lag,int _mcmc_steps){
-    unsigned seed1= std::chrono::system_clock::now().time_since_epoch().count();
-    generator.seed(seed1);
     n_particles=_n_particles;
     fixed_lag=_fixed_lag;
     mcmc_steps=_mcmc_steps;
@@ -18,36 +16,43 @@ pmmh::pmmh(int _n_particles,int _fixed_lag,int _mcmc_steps){
 
 pmmh::~pmmh(){
     if(is_initialized()) delete filter;
-    images = vector<Mat>();
+}
+
+/* the window starts as the first frames of the sequence (the lag, or all of
+them with lag 0) and then slides over the frames given to update */
+void pmmh::initialize_window(vector<Mat>& _images, Rect ground_truth){
+    int window=(fixed_lag >= (int)_images.size() || fixed_lag==0) ? (int)_images.size() : fixed_lag;
+    frames.reset(window);
+    for(int k=0;k<window;++k) frames.push_back(_images[k].clone());
+    estimates.reset(window);
+    estimates.push_back(ground_truth);
+    preloaded_frames=window;
+    frames_seen=1;
 }
 
 void pmmh::initialize(vector<Mat> _images, Rect ground_truth){
     //std::gamma_distribution<double> prior(SHAPE,SCALE);
     filter=new particle_filter(n_particles);
-    images=_images;
-    filter->initialize(images[0],ground_truth);
+    initialize_window(_images,ground_truth);
+    filter->initialize(frames.front(),ground_truth);
     reference_roi=ground_truth;
     theta_x=filter->get_dynamic_model();
     initialized=true;
-    estimates.clear();
-    estimates.push_back(ground_truth);
     matrix_pos=MatrixXd::Zero(mcmc_steps, 2);
     matrix_width=MatrixXd::Zero(mcmc_steps, 2);
-    matrix_haar_mu=MatrixXd::Zero(mcmc_steps, filter->haar.featureNum);
-    matrix_haar_std=MatrixXd::Zero(mcmc_steps, filter->haar.featureNum);
+    matrix_haar_mu=MatrixXd::Zero(mcmc_steps, filter->featureSize());
+    matrix_haar_std=MatrixXd::Zero(mcmc_steps, filter->featureSize());
 }
 
 void pmmh::initialize(vector<Mat> _images, Rect ground_truth,vector<VectorXd> _theta_x){
     //std::gamma_distribution<double> prior(SHAPE,SCALE);
     filter=new particle_filter(n_particles);
-    images=_images;
-    filter->initialize(images[0],ground_truth);
+    initialize_window(_images,ground_truth);
+    filter->initialize(frames.front(),ground_truth);
     reference_roi=ground_truth;
     theta_x=_theta_x;
     filter->update_model(theta_x);
     initialized=true;
-    estimates.clear();
-    estimates.push_back(ground_truth);
     matrix_pos=MatrixXd::Zero(mcmc_steps, 2);
     matrix_width=MatrixXd::Zero(mcmc_steps, 2);
 }
@@ -66,25 +71,30 @@ void pmmh::reinitialize(Mat& current_frame, Rect ground_truth){
 }
 
 void pmmh::predict(){
+    PROFILE_SCOPE("pmmh.predict");
     filter->predict();
 }
 
 void pmmh::update(Mat& image){
+    PROFILE_SCOPE("pmmh.update");
+    // frames of the initial window are already stored, the caller may draw
+    // on the image afterwards so later frames are copied into the window
+    frames_seen++;
+    if(frames_seen>preloaded_frames) image.copyTo(frames.push_back());
     filter->update(image);
 }
 
 double pmmh::marginal_likelihood(vector<VectorXd> theta_x){
+    PROFILE_SCOPE("pmmh.rerun");
     particle_filter proposal_filter(n_particles);
-    //int data_size=(int)images.size();
-    //int data_size=fixed_lag;
-    int data_size=(fixed_lag >= (int)images.size() || fixed_lag==0) ? (int)images.size() : fixed_lag;
+    int data_size=frames.size();
     int time_step= 0 ;
-    Mat current_frame = images.front().clone(); 
+    Mat current_frame = frames.front().clone(); 
     proposal_filter.initialize(current_frame,estimates.front());
     proposal_filter.update_model(theta_x);
     for(int k=time_step;k<data_size;++k){
         //cout << "time step:" << k << ", ML: " << proposal_filter.getMarginalLikelihood() << endl;
-        current_frame = images.at(k).clone();
+        current_frame = frames[k].clone();
         proposal_filter.predict();
         proposal_filter.update(current_frame);
     }
@@ -131,6 +141,7 @@ double pmmh::gamma_prior(VectorXd x, double a, double b)
 
 
 void pmmh::run_mcmc(){
+    PROFILE_SCOPE("pmmh.run_mcmc");
     uniform_real_distribution<double> unif_rnd(0.0,1.0);
     double forward_filter = marginal_likelihood(theta_x);
     double accept_rate=0;
@@ -160,13 +171,16 @@ void pmmh::run_mcmc(){
             filter->update_model(theta_x);
             forward_filter=proposal_filter;
             accept_rate++;
+            PROFILE_COUNT("mcmc_accepted",1);
             }
         else {
             theta_x_prop=theta_x;
         }
+        PROFILE_COUNT("mcmc_proposals",1);
         matrix_pos.row(n)=theta_x_prop.at(0).transpose() ;
         matrix_width.row(n)=theta_x_prop.at(1).transpose();  
     }
+    if(mcmc_steps>0) PROFILE_GAUGE("mcmc_acceptance_rate",accept_rate/mcmc_steps);
 }
 
 Rect pmmh::estimate(Mat& image,bool draw){
@@ -12,6 +12,7 @@
 #include <opencv2/core/eigen.hpp>
 #include "particle_filter.hpp"
 #include "../utils/utils.hpp"
+#include "../utils/ring_buffer.hpp"
 
 //C
 #include <stdio.h>
@@ -33,12 +34,14 @@ private:
     double igamma_prior(VectorXd x,double a,double b);
     double gamma_prior(VectorXd x,double a,double b);
     VectorXd proposal(VectorXd theta,double step_size);
-    vector<Mat> images;
+    void initialize_window(vector<Mat>& _images, Rect ground_truth);
+    ring_buffer<Mat> frames; /** lag window replayed by marginal_likelihood */
+    ring_buffer<Rect> estimates; /** estimates[k] is the estimate on frames[k] */
+    int preloaded_frames,frames_seen;
     Rect reference_roi;
-    mt19937 generator;
+    RandomStream generator;
     particle_filter* filter;
     vector<VectorXd> theta_x,theta_x_prop;
-    vector<Rect> estimates;
     int n_particles,n_theta,fixed_lag,mcmc_steps;
     MatrixXd matrix_pos,matrix_width,matrix_haar_mu,matrix_haar_std;
     bool initialized;
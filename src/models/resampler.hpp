@@ -0,0 +1,48 @@
+/**
+ * @file resampler.hpp
+ * @brief resampling policies of the particle filter
+ * @details resample() fills ancestors with the index of the particle every
+ * new particle is copied from, given the running sum of the normalized
+ * weights (last entry 1).
+ */
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+#include <algorithm>
+#include "../utils/random.hpp"
+
+using namespace std;
+
+/* one uniform and one binary search per particle, O(N log N) */
+class multinomial_resampler {
+public:
+    static void resample(const vector<float>& cumulative_sum, RandomStream& generator, vector<int>& ancestors){
+        int n_particles = cumulative_sum.size();
+        ancestors.resize(n_particles);
+        for (int i=0; i<n_particles; i++) {
+            float uni_rand = generator.uniform();
+            vector<float>::const_iterator pos = lower_bound(cumulative_sum.begin(), cumulative_sum.end(), uni_rand);
+            ancestors[i] = min((int)distance(cumulative_sum.begin(), pos), n_particles-1);
+        }
+    }
+};
+
+/* a single uniform offset and one merge pass over the sorted positions,
+O(N) and with lower variance than multinomial resampling */
+class systematic_resampler {
+public:
+    static void resample(const vector<float>& cumulative_sum, RandomStream& generator, vector<int>& ancestors){
+        int n_particles = cumulative_sum.size();
+        ancestors.resize(n_particles);
+        float step = 1.0f/n_particles;
+        float position = step*generator.uniform();
+        int j = 0;
+        for (int i=0; i<n_particles; i++, position+=step) {
+            while (j < n_particles-1 && cumulative_sum[j] < position) j++;
+            ancestors[i] = j;
+        }
+    }
+};
+
+#endif // RESAMPLER_H
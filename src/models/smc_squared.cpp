@@ -7,8 +7,6 @@ const float PRIOR_SD=0.01;
 const float SMC_THRESHOLD=0.1;
 
 smc_squared::smc_squared(int _n_particles,int _m_particles,int _fixed_lag,int _mcmc_steps){
-    unsigned seed1= std::chrono::system_clock::now().time_since_epoch().count();
-    generator.seed(seed1);
     n_particles=_n_particles;
     m_particles=_m_particles;
     fixed_lag=_fixed_lag;
@@ -25,6 +23,7 @@ smc_squared::~smc_squared(){
 }
 
 void smc_squared::initialize(Mat& current_frame, Rect ground_truth){
+    PROFILE_SCOPE("smc_squared.initialize");
     //cout << "initialize!" << endl;
     theta_weights.clear();
     //cout << "smc_squared" << endl;
@@ -65,6 +64,7 @@ void smc_squared::reinitialize(){
 }
 
 void smc_squared::predict(){
+    PROFILE_SCOPE("smc_squared.predict");
     for(int j=0;j<m_particles;++j){
         filter_bank[j]->predict();
     }
@@ -105,6 +105,7 @@ double smc_squared::gamma_prior(VectorXd x, double a, double b)
 
 
 void smc_squared::update(Mat& current_frame){
+    PROFILE_SCOPE("smc_squared.update");
     images.push_back(current_frame);
     normal_distribution<double> negative_random_pos(0.0,40.0);
     Size im_size=current_frame.size();
@@ -127,8 +128,11 @@ void smc_squared::update(Mat& current_frame){
         box.height=MIN(MAX(cvRound(positive_examples[i].height),0),im_size.height-box.y);
         negative_examples.push_back(box); 
     }
-    for(int j=0;j<m_particles;++j){
-        filter_bank[j]->update_model(current_frame,positive_examples,negative_examples);
+    {
+        PROFILE_SCOPE("smc_squared.update_model");
+        for(int j=0;j<m_particles;++j){
+            filter_bank[j]->update_model(current_frame,positive_examples,negative_examples);
+        }
     }
     //resample();
 }
@@ -175,6 +179,7 @@ void smc_squared::draw_particles(Mat& image){
 }
 
 void smc_squared::resample(){
+    PROFILE_SCOPE("smc_squared.resample");
     vector<float> cumulative_sum(m_particles);
     vector<float> normalized_weights(m_particles);
     vector<float> new_weights(m_particles);
@@ -200,8 +205,10 @@ void smc_squared::resample(){
     sum_weights=sum(normalized_weights);
     Scalar sum_squared_weights=sum(squared_normalized_weights);
     float ESS=sum_squared_weights[0];
+    PROFILE_GAUGE("smc_squared_ess",ESS);
     //cout << "ESS: " << ESS  << endl;
     if(isless(ESS,(float)SMC_THRESHOLD)){
+        PROFILE_COUNT("smc_squared_resample_events",1);
         vector<particle_filter*> new_filter_bank(m_particles);
         for (int i=0; i<m_particles; i++) {
             float uni_rand = unif_rnd(generator);
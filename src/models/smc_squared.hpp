@@ -35,7 +35,7 @@ private:
     VectorXd proposal(VectorXd theta,double step_size);
     vector<Mat> images;
     Rect reference_roi;
-    mt19937 generator;
+    RandomStream generator;
     vector<particle_filter*> filter_bank;
     MatrixXd theta_x_pos,theta_x_scale;
     vector<VectorXd> theta_x_prop,theta_x;
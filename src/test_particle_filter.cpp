@@ -1,6 +1,7 @@
 #include "models/particle_filter.hpp"
 #include "utils/utils.hpp"
 #include "utils/image_generator.hpp"
+#include "utils/tracker_config.hpp"
 
 #include <time.h>
 #include <iostream>
@@ -11,10 +12,11 @@ using namespace cv;
 
 class TestParticleFilter{
 public:
-  TestParticleFilter(string _firstFrameFilename, string _gtFilename, int _num_particles);
+  TestParticleFilter(string _firstFrameFilename, string _gtFilename, TrackerConfig _config);
   void run();
 private:
   int num_particles,num_frames;
+  TrackerConfig config;
   imageGenerator generator;
   double reinit_rate;
   //discrete_particle_filter filter;
@@ -23,16 +25,17 @@ private:
   vector<string> gt_vec;
 };
 
-TestParticleFilter::TestParticleFilter(string _firstFrameFilename, string _gtFilename, int _num_particles){
+TestParticleFilter::TestParticleFilter(string _firstFrameFilename, string _gtFilename, TrackerConfig _config){
   imageGenerator generator(_firstFrameFilename,_gtFilename);
-  num_particles = _num_particles;
+  config = _config;
+  num_particles = config.n_particles;
   num_frames = generator.getDatasetSize();
   gt_vec = generator.ground_truth;
   images = generator.images;
 }
 
 void TestParticleFilter::run(){
-  particle_filter filter(num_particles);
+  particle_filter filter(num_particles, config);
   Rect ground_truth;
   Mat current_frame; 
   string current_gt;
@@ -72,19 +75,36 @@ void TestParticleFilter::run(){
   cout  << performance.get_avg_precision()/(num_frames-reinit_rate);
   cout << "," << performance.get_avg_recall()/(num_frames-reinit_rate);
   cout << "," << num_frames/sec << "," << reinit_rate <<  "," << num_frames << endl;
+  if(config.fixed_lag>0){
+    // smoothed track, config.fixed_lag frames behind the online one
+    filter.flush_smoother();
+    Performance smoothed_performance;
+    for(size_t i=0;i<filter.smoothed_estimates.size();++i){
+      Rect smoothed_ground_truth=generator.stringToRect(gt_vec[filter.smoothed_frames[i]]);
+      smoothed_performance.calc(smoothed_ground_truth, filter.smoothed_estimates[i]);
+    }
+    int num_smoothed=MAX((int)filter.smoothed_estimates.size(),1);
+    cout << "smoothed," << smoothed_performance.get_avg_precision()/num_smoothed;
+    cout << "," << smoothed_performance.get_avg_recall()/num_smoothed << "," << num_smoothed << endl;
+  }
+#ifdef PROFILING
+  Profiler::instance().write_chrome_trace("tracker_trace.json");
+  Profiler::instance().write_prometheus("tracker_metrics.prom");
+#endif
 };
 
 int main(int argc, char* argv[]){
     
     
-    if(argc != 7) {
+    // -img and -gt first, then any "-key value" of TrackerConfig
+    // (e.g. -npart 300 -feature lbp -likelihood lr -config tracker.cfg)
+    if(argc < 5 || argc % 2 != 1) {
         cerr <<"Incorrect input list" << endl;
         cerr <<"exiting..." << endl;
         return EXIT_FAILURE;
     }
     else{
         string _firstFrameFilename,_gtFilename;
-        int _num_particles;
         if(strcmp(argv[1], "-img") == 0) {
             _firstFrameFilename=argv[2];
         }
@@ -101,13 +121,13 @@ int main(int argc, char* argv[]){
             cerr <<"exiting..." << endl;
             return EXIT_FAILURE;
         }
-        if(strcmp(argv[5], "-npart") == 0) {
-            _num_particles=atoi(argv[6]);
-        }
-        else{
-            _num_particles=300;
+        TrackerConfig _config;
+        if(!_config.parse_args(argc-5, argv+5)) {
+            cerr <<"exiting..." << endl;
+            return EXIT_FAILURE;
         }
-        TestParticleFilter tracker(_firstFrameFilename,_gtFilename,_num_particles);
+        set_random_seed(_config.seed);
+        TestParticleFilter tracker(_firstFrameFilename,_gtFilename,_config);
         tracker.run();
     }
 }
@@ -0,0 +1,78 @@
+/**
+ * @file test_particle_smoother.cpp
+ * @brief checks the rejection-sampled FFBSi of particle_smoother against the
+ * exact O(N^2) backward kernel
+ * @details A synthetic history is simulated from the motion model of
+ * particle_smoother::predict with random filtering weights. smoother() is run
+ * on it with many different random streams, the mean of its smoothing weights
+ * must match exact_smoother() up to the Monte Carlo error.
+ *
+ * usage: smoother_check [-npart N] [-lag L] [-runs R]
+ */
+#include "models/particle_smoother.hpp"
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char* argv[]){
+    int n_particles=40,lag=4,runs=500;
+    for(int i=1;i+1<argc;i+=2){
+        if(strcmp(argv[i],"-npart")==0) n_particles=atoi(argv[i+1]);
+        else if(strcmp(argv[i],"-lag")==0) lag=atoi(argv[i+1]);
+        else if(strcmp(argv[i],"-runs")==0) runs=atoi(argv[i+1]);
+    }
+    set_random_seed(1);
+    RandomStream generator;
+    particle_smoother smoother(n_particles,lag);
+    vector<particle> states(n_particles);
+    for (int i=0;i<n_particles;i++){
+        particle& state=states[i];
+        state.x=100.0f+3.0f*generator.normal();
+        state.y=100.0f+3.0f*generator.normal();
+        state.x_p=state.x-generator.normal();
+        state.y_p=state.y-generator.normal();
+        state.width=state.height=20.0f;
+    }
+    for (int k=0;k<=lag;k++){
+        if(k>0){
+            // same move as particle_smoother::predict, from a resampled parent
+            vector<particle> parents=states;
+            for (int i=0;i<n_particles;i++){
+                const particle& parent=parents[min((int)(generator.uniform()*n_particles),n_particles-1)];
+                particle& state=states[i];
+                float vx=parent.x-parent.x_p+generator.normal();
+                float vy=parent.y-parent.y_p+generator.normal();
+                state.x=parent.x+vx+generator.normal();
+                state.y=parent.y+vy+generator.normal();
+                state.x_p=state.x-vx;
+                state.y_p=state.y-vy;
+            }
+        }
+        particle_slice& slice=smoother.history.push(states,k);
+        for (int i=0;i<n_particles;i++) slice.weights(i)=0.1f+generator.uniform();
+        slice.weights/=slice.weights.sum();
+    }
+
+    smoother.exact_smoother(lag);
+    vector<float> exact=smoother.smoothing_weights;
+    vector<double> mean(n_particles,0.0);
+    for (int r=0;r<runs;r++){
+        // smoother() keys its streams on the newest time stamp
+        smoother.history.back().time_stamp=lag+r;
+        smoother.smoother(lag);
+        for (int i=0;i<n_particles;i++) mean[i]+=smoother.smoothing_weights[i]/runs;
+    }
+    double max_error=0.0,max_tolerance=0.0;
+    bool passed=true;
+    for (int i=0;i<n_particles;i++){
+        // 5 standard deviations of the mean of runs*n_particles draws
+        double tolerance=5.0*sqrt(max(exact[i]*(1.0-exact[i]),1e-4)/((double)runs*n_particles));
+        double error=fabs(mean[i]-exact[i]);
+        if(error>tolerance) passed=false;
+        max_error=max(max_error,error);
+        max_tolerance=max(max_tolerance,tolerance);
+    }
+    cout << "particles " << n_particles << ", lag " << lag << ", runs " << runs
+         << ", max |mean - exact| " << max_error << " (tolerance up to " << max_tolerance << ")" << endl;
+    cout << (passed ? "PASSED" : "FAILED") << endl;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -70,6 +70,10 @@ void TestPMMH::run(){
   cout  << performance.get_avg_precision()/(num_frames-reinit_rate);
   cout << "," << performance.get_avg_recall()/(num_frames-reinit_rate);
   cout << "," << num_frames/sec << "," << reinit_rate <<  "," << num_frames << endl;
+#ifdef PROFILING
+  Profiler::instance().write_chrome_trace("tracker_trace.json");
+  Profiler::instance().write_prometheus("tracker_metrics.prom");
+#endif
 };
 
 int main(int argc, char* argv[]){
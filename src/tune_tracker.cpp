@@ -0,0 +1,406 @@
+/**
+ * @file tune_tracker.cpp
+ * @brief offline tuning of the tracker parameters with CMA-ES
+ * @details Every candidate parameter set is run on every sequence of the list
+ * (frames are loaded once and shared read-only), the (candidate, sequence,
+ * repeat) runs of a CMA-ES population are spread over the OpenMP threads.
+ * Every run draws from streams keyed by (evaluation, sequence, repeat), so it
+ * is reproducible from the seed whatever thread it lands on.
+ * The cost is minus the mean overlap precision, penalized by the failure rate
+ * and by the speed shortfall below the target frame rate. The frame rate is
+ * measured in CPU time of the thread that runs the sequence, so it does not
+ * depend on how many runs share the machine.
+ *
+ * usage: tuner -list sequences.txt [-npart N] [-iter N] [-repeats N]
+ *              [-fps F] [-init params.cfg] [-checkpoint tune.cfg] [-out best.cfg]
+ *              [-config tracker.cfg]
+ * the feature and likelihood under tuning come from the -config file, the
+ * search covers haar_features only when the feature is Haar
+ * the checkpoint holds the CMA-ES state, the best score and the evaluation
+ * count after every iteration; when it exists the run resumes from it, and
+ * -iter bounds the iterations of both runs together
+ * each line of sequences.txt holds "first_frame_filename ground_truth_filename"
+ */
+#include "models/particle_filter.hpp"
+#include "utils/utils.hpp"
+#include "utils/image_generator.hpp"
+#include "utils/tracker_config.hpp"
+#include "utils/random.hpp"
+#include "libs/cppoptlib/boundedproblem.h"
+#include "libs/cppoptlib/solver/cmaesbsolver.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <ctime>
+#include <type_traits>
+
+using namespace std;
+using namespace cv;
+
+const int TUNING_COMMON_DIM=4; /** pos_std, threshold, overlap_ratio, learning_rate */
+const float FAILURE_OVERLAP=0.1;
+const double FAILURE_PENALTY=0.5;
+
+typedef struct sequence {
+    string name;
+    vector<Mat> images;
+    vector<Rect> ground_truth;
+} sequence;
+
+static double thread_cpu_seconds(){
+    // every run is single threaded (OpenCV is limited to one thread and Eigen
+    // does not nest inside the parallel loop), its thread time is its cost
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&now);
+    return now.tv_sec+1e-9*now.tv_nsec;
+}
+
+typedef struct tracking_result {
+    double precision;
+    double recall;
+    double fps;
+    int failures;
+    int num_frames;
+} tracking_result;
+
+tracking_result run_tracker(const sequence& seq, const TrackerConfig& config){
+    // same protocol as TestParticleFilter::run, without display
+    tracking_result result;
+    particle_filter filter(config.n_particles, config);
+    Performance performance;
+    int failures=0;
+    int num_frames=seq.images.size();
+    double start=thread_cpu_seconds();
+    for(int k=0;k<num_frames;++k){
+        Mat current_frame=seq.images[k];
+        if(!filter.is_initialized()){
+            filter.initialize(current_frame,seq.ground_truth[k]);
+        }else{
+            filter.predict();
+            filter.update(current_frame);
+            Rect estimate=filter.estimate(current_frame,false);
+            double r1=performance.calc(seq.ground_truth[k],estimate);
+            if(r1<FAILURE_OVERLAP){
+                filter.reinitialize();
+                failures++;
+            }
+        }
+    }
+    double sec=thread_cpu_seconds()-start;
+    result.precision=performance.get_avg_precision()/max(num_frames-failures,1);
+    result.recall=performance.get_avg_recall()/max(num_frames-failures,1);
+    result.fps=num_frames/max(sec,1e-9);
+    result.failures=failures;
+    result.num_frames=num_frames;
+    return result;
+}
+
+static bool tunes_haar_features(const TrackerConfig& config){
+#if defined(TRACKER_FEATURE)
+    // the pipeline is fixed at build time, the configured feature is ignored
+    return is_same<TRACKER_FEATURE,haar_feature>::value;
+#else
+    return config.feature==FEATURE_HAAR;
+#endif
+}
+
+static int tuning_dim(const TrackerConfig& config){
+    return tunes_haar_features(config) ? TUNING_COMMON_DIM+1 : TUNING_COMMON_DIM;
+}
+
+typedef cppoptlib::CMAesState<double> search_state;
+
+class TrackerTuning : public cppoptlib::BoundedProblem<double> {
+public:
+    using Superclass = cppoptlib::BoundedProblem<double>;
+    using typename Superclass::TVector;
+    using typename Superclass::TMatrix;
+    using typename Superclass::TValues;
+
+    TrackerTuning(vector<sequence>& _sequences, const TrackerConfig& _base_config, int _repeats, double _target_fps,
+        const string& _checkpoint_file, const string& _output_file) :
+        Superclass(TVector::Zero(tuning_dim(_base_config)), TVector::Ones(tuning_dim(_base_config))),
+        sequences(_sequences){
+        base_config=_base_config;
+        repeats=_repeats;
+        target_fps=_target_fps;
+        checkpoint_file=_checkpoint_file;
+        output_file=_output_file;
+        best_cost=std::numeric_limits<double>::infinity();
+        evaluations=0;
+        solver_state=NULL;
+    }
+
+    /** the search runs in [0,1]^4, or [0,1]^5 with haar_features for the Haar
+    feature, mapped onto the parameter ranges; the parameters left out
+    (scale_std, which the motion model does not use, haar_pool, and
+    haar_features for the other features) keep their value from base */
+    static TrackerParams decode(const TVector& x, const TrackerParams& base){
+        TVector u=x.cwiseMax(0.0).cwiseMin(1.0);
+        TrackerParams params=base;
+        params.pos_std=0.1+u(0)*(10.0-0.1);
+        params.threshold=0.05+u(1)*(1.0-0.05);
+        params.overlap_ratio=0.3+u(2)*(0.95-0.3);
+        params.learning_rate=0.01+u(3)*(0.9-0.01);
+        if(u.size()>TUNING_COMMON_DIM) params.haar_features=(int)round(10+u(4)*(200-10));
+        return params;
+    }
+
+    static TVector encode(const TrackerParams& params, int dim){
+        TVector x(dim);
+        x.head(TUNING_COMMON_DIM) << (params.pos_std-0.1)/(10.0-0.1),
+             (params.threshold-0.05)/(1.0-0.05), (params.overlap_ratio-0.3)/(0.95-0.3),
+             (params.learning_rate-0.01)/(0.9-0.01);
+        if(dim>TUNING_COMMON_DIM) x(4)=(params.haar_features-10.0)/(200-10);
+        return x.cwiseMax(0.0).cwiseMin(1.0);
+    }
+
+    double value(const TVector& x){
+        TMatrix X=x;
+        TValues f;
+        valueBatch(X,f);
+        return f(0);
+    }
+
+    void valueBatch(const TMatrix& X, TValues& f){
+        const int N=X.cols();
+        const int S=sequences.size();
+        vector<TrackerConfig> candidates(N,base_config);
+        for(int k=0;k<N;++k) candidates[k].params=decode(X.col(k),base_config.params);
+        vector<tracking_result> results(N*S*repeats);
+        // one cell per (candidate, sequence, repeat), longest sequences dominate
+        // the wall time so cells are handed out dynamically
+        #pragma omp parallel for schedule(dynamic)
+        for(int cell=0;cell<N*S*repeats;++cell){
+            int k=cell/(S*repeats);
+            int s=(cell/repeats)%S;
+            random_scope scope(generator,(uint64_t)evaluations*S*repeats+cell);
+            results[cell]=run_tracker(sequences[s],candidates[k]);
+        }
+        f.resize(N);
+        for(int k=0;k<N;++k){
+            double precision=0.0,failure_rate=0.0,fps=0.0;
+            for(int c=k*S*repeats;c<(k+1)*S*repeats;++c){
+                precision+=results[c].precision;
+                failure_rate+=(double)results[c].failures/max(results[c].num_frames,1);
+                fps+=results[c].fps;
+            }
+            precision/=S*repeats;
+            failure_rate/=S*repeats;
+            fps/=S*repeats;
+            double score=precision-FAILURE_PENALTY*failure_rate;
+            if(target_fps>0 && fps<target_fps) score-=(1.0-fps/target_fps);
+            f(k)=-score;
+            if(f(k)<best_cost){
+                best_cost=f(k);
+                best_params=candidates[k].params;
+                cout << "new best " << -best_cost << " (precision " << precision << ", failure rate " << failure_rate
+                     << ", fps " << fps << ")" << endl;
+                if(!output_file.empty()) best_params.save(output_file);
+            }
+        }
+        evaluations+=N;
+    }
+
+    bool callback(const cppoptlib::Criteria<double>& state, const TVector& x){
+        cout << "iteration " << state.iterations << ", evaluations " << evaluations
+             << ", best score " << -best_cost << endl;
+        if(!checkpoint_file.empty() && solver_state) save_checkpoint(*solver_state);
+        return true;
+    }
+
+    /** the solver state written with every checkpoint, the solver updates
+    it before calling callback */
+    void watch(const search_state* _solver_state){
+        solver_state=_solver_state;
+    }
+
+    bool save_checkpoint(const search_state& state){
+        ofstream file(checkpoint_file.c_str());
+        if(!file.is_open()){
+            cout << "Error: cannot write checkpoint " << checkpoint_file << endl;
+            return false;
+        }
+        file << setprecision(17);
+        file << "evaluations " << evaluations << endl;
+        file << "best_cost " << best_cost << endl;
+        file << "iterations " << state.iterations << endl;
+        file << "sigma " << state.sigma << endl;
+        file << "xmean " << state.xmean.transpose() << endl;
+        file << "pc " << state.pc.transpose() << endl;
+        file << "ps " << state.ps.transpose() << endl;
+        file << "gamma " << state.gamma.transpose() << endl;
+        file << "C";
+        for(int i=0;i<state.C.size();++i) file << " " << state.C(i);
+        file << endl;
+        // "best key value" lines, parsed back by TrackerParams::set
+        ostringstream params_text;
+        best_params.print(params_text);
+        istringstream lines(params_text.str());
+        string line;
+        while(getline(lines,line)) file << "best " << line << endl;
+        return file.good();
+    }
+
+    bool load_checkpoint(search_state& state){
+        ifstream file(checkpoint_file.c_str());
+        if(!file.is_open()) return false;
+        const int n=lowerBound().size();
+        state.xmean=state.pc=state.ps=state.gamma=TVector::Zero(n);
+        state.C=THessian::Zero(n,n);
+        int found=0;
+        string line;
+        while(getline(file,line)){
+            istringstream fields(line);
+            string key;
+            if(!(fields >> key)) continue;
+            bool parsed=true;
+            if(key=="evaluations") parsed=(bool)(fields >> evaluations);
+            else if(key=="best_cost") parsed=(bool)(fields >> best_cost);
+            else if(key=="iterations") parsed=(bool)(fields >> state.iterations);
+            else if(key=="sigma") parsed=(bool)(fields >> state.sigma);
+            else if(key=="xmean") parsed=read_values(fields,state.xmean.data(),n);
+            else if(key=="pc") parsed=read_values(fields,state.pc.data(),n);
+            else if(key=="ps") parsed=read_values(fields,state.ps.data(),n);
+            else if(key=="gamma") parsed=read_values(fields,state.gamma.data(),n);
+            else if(key=="C") parsed=read_values(fields,state.C.data(),n*n);
+            else if(key=="best"){
+                string param;
+                parsed=(fields >> param) && best_params.set(param,fields)==1;
+            }
+            else parsed=false;
+            if(!parsed){
+                cout << "Error: bad checkpoint line \"" << line << "\" in " << checkpoint_file << endl;
+                return false;
+            }
+            if(key!="best") found++;
+        }
+        if(found<9){
+            cout << "Error: incomplete checkpoint " << checkpoint_file << endl;
+            return false;
+        }
+        // the parameters outside the search keep the values of the first run
+        base_config.params=best_params;
+        return true;
+    }
+
+    TrackerParams getBestParams(){
+        return best_params;
+    }
+
+private:
+    vector<sequence>& sequences;
+    TrackerConfig base_config;
+    int repeats;
+    double target_fps;
+    string checkpoint_file,output_file;
+    double best_cost;
+    TrackerParams best_params;
+    long evaluations;
+    RandomStream generator; /** parent of the streams of every run */
+    const search_state* solver_state;
+
+    static bool read_values(istream& fields, double* values, int n){
+        for(int i=0;i<n;++i){
+            if(!(fields >> values[i])) return false;
+        }
+        string extra;
+        return !(fields >> extra);
+    }
+};
+
+bool load_sequences(const string& list_file, vector<sequence>& sequences){
+    ifstream file(list_file.c_str());
+    if(!file.is_open()){
+        cout << "Error: cannot open sequence list " << list_file << endl;
+        return false;
+    }
+    string first_frame,gt_file;
+    while(file >> first_frame >> gt_file){
+        imageGenerator generator(first_frame,gt_file);
+        sequence seq;
+        seq.name=first_frame;
+        seq.images=generator.images;
+        for(size_t k=0;k<generator.ground_truth.size();++k){
+            seq.ground_truth.push_back(generator.stringToRect(generator.ground_truth[k]));
+        }
+        if(seq.images.empty() || seq.images.size()!=seq.ground_truth.size()){
+            cout << "Error: inconsistent sequence " << first_frame << endl;
+            return false;
+        }
+        cout << "loaded " << seq.name << ", " << seq.images.size() << " frames" << endl;
+        sequences.push_back(seq);
+    }
+    return !sequences.empty();
+}
+
+int main(int argc, char* argv[]){
+    string list_file,init_file,checkpoint_file="tune_checkpoint.cfg",output_file="best_params.cfg";
+    int n_particles=0,iterations=50,repeats=1;
+    TrackerConfig base_config;
+    double target_fps=0.0;
+    for(int i=1;i+1<argc;i+=2){
+        if(strcmp(argv[i],"-list")==0) list_file=argv[i+1];
+        else if(strcmp(argv[i],"-npart")==0) n_particles=atoi(argv[i+1]);
+        else if(strcmp(argv[i],"-iter")==0) iterations=atoi(argv[i+1]);
+        else if(strcmp(argv[i],"-repeats")==0) repeats=atoi(argv[i+1]);
+        else if(strcmp(argv[i],"-fps")==0) target_fps=atof(argv[i+1]);
+        else if(strcmp(argv[i],"-init")==0) init_file=argv[i+1];
+        else if(strcmp(argv[i],"-checkpoint")==0) checkpoint_file=argv[i+1];
+        else if(strcmp(argv[i],"-out")==0) output_file=argv[i+1];
+        else if(strcmp(argv[i],"-config")==0){
+            if(!base_config.load(argv[i+1])) return EXIT_FAILURE;
+        }
+        else{
+            cerr << "Unknown option " << argv[i] << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if(list_file.empty()){
+        cerr << "No sequence list given" << endl;
+        cerr << "exiting..." << endl;
+        return EXIT_FAILURE;
+    }
+    vector<sequence> sequences;
+    if(!load_sequences(list_file,sequences)) return EXIT_FAILURE;
+    // the runs are parallel already, keep OpenCV from oversubscribing
+    setNumThreads(1);
+
+    if(n_particles>0) base_config.n_particles=n_particles;
+    set_random_seed(base_config.seed);
+    TrackerParams init_params=base_config.params;
+    if(!init_file.empty()){
+        init_params.load(init_file);
+    }
+    base_config.params=init_params;
+
+    TrackerTuning tuning(sequences,base_config,repeats,target_fps,checkpoint_file,output_file);
+    cppoptlib::CMAesBSolver<TrackerTuning> solver;
+    TrackerTuning::TVector x=TrackerTuning::encode(init_params,tuning_dim(base_config));
+    ifstream checkpoint(checkpoint_file.c_str());
+    if(checkpoint.good()){
+        search_state state;
+        if(!tuning.load_checkpoint(state)) return EXIT_FAILURE;
+        cout << "resuming from " << checkpoint_file << " at iteration " << state.iterations << endl;
+        solver.resume(state);
+        x=state.xmean;
+    }
+    tuning.watch(&solver.state());
+    cppoptlib::Criteria<double> crit=cppoptlib::Criteria<double>::defaults();
+    crit.iterations=iterations;
+    crit.gradNorm=0; // derivative free
+    crit.xDelta=1e-4;
+    crit.fDelta=0; // the cost is noisy, equal best costs do not mean convergence
+    crit.condition=1e14;
+    solver.setStopCriteria(crit);
+    solver.minimize(tuning,x);
+
+    TrackerParams best=tuning.getBestParams();
+    cout << "best parameters (" << output_file << "):" << endl;
+    best.print(cout);
+    best.save(output_file);
+    return EXIT_SUCCESS;
+}
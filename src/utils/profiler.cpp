@@ -0,0 +1,137 @@
+/**
+ * @file profiler.cpp
+ * @brief hot-path counters, phase timers and trace exporters
+ */
+#include "profiler.hpp"
+#include <omp.h>
+
+Profiler::Profiler(){
+    origin=chrono::steady_clock::now();
+    max_events=1<<20; // keep the trace bounded on long sequences
+}
+
+Profiler& Profiler::instance(){
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now(){
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now()-origin).count();
+}
+
+void Profiler::count(const string& name, double value){
+    lock_guard<mutex> guard(lock);
+    counters[name]+=value;
+}
+
+void Profiler::gauge(const string& name, double value){
+    lock_guard<mutex> guard(lock);
+    gauges[name]=value;
+}
+
+void Profiler::record(const string& name, int64_t start, int64_t duration){
+    lock_guard<mutex> guard(lock);
+    phase_stats& stats=phases[name];
+    double seconds=duration*1e-6;
+    stats.total+=seconds;
+    stats.max=max(stats.max,seconds);
+    stats.calls++;
+    if(events.size()<max_events){
+        trace_event event;
+        event.name=name;
+        event.start=start;
+        event.duration=duration;
+        event.thread=omp_get_thread_num();
+        events.push_back(event);
+    }
+}
+
+void Profiler::reset(){
+    lock_guard<mutex> guard(lock);
+    counters.clear();
+    gauges.clear();
+    phases.clear();
+    events.clear();
+    origin=chrono::steady_clock::now();
+}
+
+string Profiler::metric_name(const string& name){
+    string metric="tracker_";
+    for(unsigned int i=0;i<name.size();i++){
+        char c=name[i];
+        bool valid=(c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='_';
+        metric+= valid ? c : '_';
+    }
+    return metric;
+}
+
+void Profiler::write_chrome_trace(const string& filename){
+    lock_guard<mutex> guard(lock);
+    ofstream file(filename.c_str());
+    if(!file){
+        cout << "Error: cannot write trace file " << filename << endl;
+        return;
+    }
+    // Chrome trace-event format, complete ("X") events, loadable in chrome://tracing
+    file << "{\"traceEvents\":[";
+    for(unsigned int i=0;i<events.size();i++){
+        if(i>0) file << ",";
+        file << "\n{\"name\":\"" << events[i].name << "\",\"cat\":\"tracker\",\"ph\":\"X\""
+             << ",\"ts\":" << events[i].start << ",\"dur\":" << events[i].duration
+             << ",\"pid\":0,\"tid\":" << events[i].thread << "}";
+    }
+    map<string,double>::iterator iter;
+    int64_t timestamp=events.empty() ? 0 : events.back().start+events.back().duration;
+    for(iter=counters.begin();iter!=counters.end();++iter){
+        file << ",\n{\"name\":\"" << iter->first << "\",\"ph\":\"C\",\"ts\":" << timestamp
+             << ",\"pid\":0,\"args\":{\"value\":" << iter->second << "}}";
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}" << endl;
+    file.close();
+}
+
+void Profiler::write_prometheus(ostream& os){
+    lock_guard<mutex> guard(lock);
+    map<string,double>::iterator iter;
+    for(iter=counters.begin();iter!=counters.end();++iter){
+        string metric=metric_name(iter->first)+"_total";
+        os << "# TYPE " << metric << " counter" << endl;
+        os << metric << " " << iter->second << endl;
+    }
+    for(iter=gauges.begin();iter!=gauges.end();++iter){
+        string metric=metric_name(iter->first);
+        os << "# TYPE " << metric << " gauge" << endl;
+        os << metric << " " << iter->second << endl;
+    }
+    if(!phases.empty()){
+        os << "# TYPE tracker_phase_seconds summary" << endl;
+        map<string,phase_stats>::iterator phase;
+        for(phase=phases.begin();phase!=phases.end();++phase){
+            os << "tracker_phase_seconds_sum{phase=\"" << phase->first << "\"} " << phase->second.total << endl;
+            os << "tracker_phase_seconds_count{phase=\"" << phase->first << "\"} " << phase->second.calls << endl;
+        }
+        os << "# TYPE tracker_phase_seconds_max gauge" << endl;
+        for(phase=phases.begin();phase!=phases.end();++phase){
+            os << "tracker_phase_seconds_max{phase=\"" << phase->first << "\"} " << phase->second.max << endl;
+        }
+    }
+}
+
+void Profiler::write_prometheus(const string& filename){
+    ofstream file(filename.c_str());
+    if(!file){
+        cout << "Error: cannot write metrics file " << filename << endl;
+        return;
+    }
+    write_prometheus(file);
+    file.close();
+}
+
+ScopedTimer::ScopedTimer(const char* _name){
+    name=_name;
+    start=Profiler::instance().now();
+}
+
+ScopedTimer::~ScopedTimer(){
+    Profiler::instance().record(name,start,Profiler::instance().now()-start);
+}
@@ -0,0 +1,78 @@
+/**
+ * @file profiler.hpp
+ * @brief hot-path counters and scoped phase timers
+ * @details Everything is compiled out unless PROFILING is defined, so the
+ * PROFILE_* macros cost nothing in production builds.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
+
+using namespace std;
+
+typedef struct trace_event {
+    string name; /** phase name */
+    int64_t start; /** start time in microseconds since profiler creation */
+    int64_t duration; /** duration in microseconds */
+    int thread; /** OpenMP thread id */
+} trace_event;
+
+typedef struct phase_stats {
+    double total; /** accumulated seconds */
+    double max; /** slowest call in seconds */
+    long calls; /** number of calls */
+} phase_stats;
+
+class Profiler {
+public:
+    static Profiler& instance();
+    void count(const string& name, double value=1.0);
+    void gauge(const string& name, double value);
+    void record(const string& name, int64_t start, int64_t duration);
+    int64_t now();
+    void reset();
+    void write_chrome_trace(const string& filename);
+    void write_prometheus(ostream& os);
+    void write_prometheus(const string& filename);
+private:
+    Profiler();
+    string metric_name(const string& name);
+    mutex lock;
+    chrono::steady_clock::time_point origin;
+    map<string,double> counters, gauges;
+    map<string,phase_stats> phases;
+    vector<trace_event> events;
+    size_t max_events;
+};
+
+class ScopedTimer {
+public:
+    ScopedTimer(const char* _name);
+    ~ScopedTimer();
+private:
+    const char* name;
+    int64_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_INNER(a,b)
+
+#ifdef PROFILING
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(scoped_timer_,__LINE__)(name)
+#define PROFILE_COUNT(name,value) Profiler::instance().count(name,value)
+#define PROFILE_GAUGE(name,value) Profiler::instance().gauge(name,value)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(name,value) ((void)0)
+#define PROFILE_GAUGE(name,value) ((void)0)
+#endif
+
+#endif // PROFILER_H
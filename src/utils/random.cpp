@@ -0,0 +1,194 @@
+/**
+ * @file random.cpp
+ * @brief counter-based (Philox4x32-10) random streams
+ */
+#include "random.hpp"
+#include <stdlib.h>
+#include <atomic>
+
+static const uint32_t PHILOX_M0=0xD2511F53u;
+static const uint32_t PHILOX_M1=0xCD9E8D57u;
+static const uint32_t PHILOX_W0=0x9E3779B9u;
+static const uint32_t PHILOX_W1=0xBB67AE85u;
+static const int PHILOX_ROUNDS=10;
+static const double TWO_PI=6.283185307179586476925286766559;
+
+static uint64_t splitmix64(uint64_t x){
+    x+=0x9E3779B97F4A7C15ull;
+    x=(x^(x>>30))*0xBF58476D1CE4E5B9ull;
+    x=(x^(x>>27))*0x94D049BB133111EBull;
+    return x^(x>>31);
+}
+
+static uint64_t& global_seed(){
+    static uint64_t seed=0;
+    static bool initialized=false;
+    if(!initialized){
+        const char* env=getenv("TRACKER_SEED");
+        if(env) seed=strtoull(env,NULL,10);
+        initialized=true;
+    }
+    return seed;
+}
+
+static std::atomic<uint64_t>& stream_counter(){
+    static std::atomic<uint64_t> counter(0);
+    return counter;
+}
+
+uint64_t random_seed(){
+    return global_seed();
+}
+
+void set_random_seed(uint64_t seed){
+    global_seed()=seed;
+    stream_counter()=0;
+}
+
+uint64_t next_stream_id(){
+    return stream_counter()++;
+}
+
+static random_scope*& current_scope(){
+    static thread_local random_scope* scope=NULL;
+    return scope;
+}
+
+random_scope::random_scope(const RandomStream& owner, uint64_t substream) : root(owner.split(substream)){
+    count=0;
+    enclosing=current_scope();
+    current_scope()=this;
+}
+
+random_scope::~random_scope(){
+    current_scope()=enclosing;
+}
+
+RandomStream random_scope::next(){
+    return root.split(count++);
+}
+
+RandomStream::RandomStream(){
+    random_scope* scope=current_scope();
+    if(scope) *this=scope->next();
+    else seed(random_seed(),next_stream_id());
+}
+
+RandomStream::RandomStream(uint64_t _seed, uint64_t _stream){
+    seed(_seed,_stream);
+}
+
+void RandomStream::seed(uint64_t _seed, uint64_t _stream){
+    uint64_t k=splitmix64(_seed^splitmix64(_stream));
+    key[0]=(uint32_t)k;
+    key[1]=(uint32_t)(k>>32);
+    counter[0]=counter[1]=counter[2]=counter[3]=0;
+    index=4;
+    has_spare=false;
+    spare=0.0;
+}
+
+RandomStream RandomStream::split(uint64_t substream) const{
+    RandomStream child(0,0);
+    uint64_t k=((uint64_t)key[1]<<32)|key[0];
+    k=splitmix64(k^splitmix64(substream+1));
+    child.key[0]=(uint32_t)k;
+    child.key[1]=(uint32_t)(k>>32);
+    child.counter[0]=child.counter[1]=child.counter[2]=child.counter[3]=0;
+    child.index=4;
+    child.has_spare=false;
+    return child;
+}
+
+void RandomStream::generate_block(){
+    uint32_t c0=counter[0],c1=counter[1],c2=counter[2],c3=counter[3];
+    uint32_t k0=key[0],k1=key[1];
+    for(int r=0;r<PHILOX_ROUNDS;r++){
+        uint64_t p0=(uint64_t)PHILOX_M0*c0;
+        uint64_t p1=(uint64_t)PHILOX_M1*c2;
+        uint32_t hi0=(uint32_t)(p0>>32),lo0=(uint32_t)p0;
+        uint32_t hi1=(uint32_t)(p1>>32),lo1=(uint32_t)p1;
+        c0=hi1^c1^k0;
+        c1=lo1;
+        c2=hi0^c3^k1;
+        c3=lo0;
+        k0+=PHILOX_W0;
+        k1+=PHILOX_W1;
+    }
+    block[0]=c0;block[1]=c1;block[2]=c2;block[3]=c3;
+    // 128-bit counter increment
+    if(++counter[0]==0 && ++counter[1]==0 && ++counter[2]==0) ++counter[3];
+    index=0;
+}
+
+double RandomStream::uniform(){
+    // open interval (0,1), safe for log()
+    return ((*this)()+0.5)*(1.0/4294967296.0);
+}
+
+double RandomStream::normal(){
+    if(has_spare){
+        has_spare=false;
+        return spare;
+    }
+    double radius=sqrt(-2.0*log(uniform()));
+    double angle=TWO_PI*uniform();
+    spare=radius*sin(angle);
+    has_spare=true;
+    return radius*cos(angle);
+}
+
+void RandomStream::fill_uniform(Eigen::Ref<Eigen::MatrixXf> out){
+    // 24 random bits per float, open interval (0,1)
+    for(int j=0;j<out.cols();j++){
+        for(int i=0;i<out.rows();i++){
+            if(index==4){
+                generate_block();
+            }
+            out(i,j)=((block[index++]>>8)+0.5f)*(1.0f/16777216.0f);
+        }
+    }
+}
+
+void RandomStream::fill_uniform(Eigen::Ref<Eigen::MatrixXd> out){
+    for(int j=0;j<out.cols();j++){
+        for(int i=0;i<out.rows();i++){
+            out(i,j)=uniform();
+        }
+    }
+}
+
+// Batched Box-Muller: the uniforms come straight from Philox blocks and the
+// log/sqrt/sin/cos transform runs on whole Eigen arrays, which Eigen
+// vectorizes, instead of one normal_distribution call per draw.
+void RandomStream::fill_normal(Eigen::Ref<Eigen::MatrixXf> out){
+    int n=out.size();
+    int half=(n+1)/2;
+    Eigen::VectorXf u1(half),u2(half);
+    fill_uniform(u1);
+    fill_uniform(u2);
+    Eigen::ArrayXf radius=(-2.0f*u1.array().log()).sqrt();
+    Eigen::ArrayXf angle=(float)TWO_PI*u2.array();
+    Eigen::ArrayXf values(2*half);
+    values.head(half)=radius*angle.cos();
+    values.tail(half)=radius*angle.sin();
+    for(int j=0;j<out.cols();j++){
+        out.col(j)=values.segment(j*out.rows(),out.rows()).matrix();
+    }
+}
+
+void RandomStream::fill_normal(Eigen::Ref<Eigen::MatrixXd> out){
+    int n=out.size();
+    int half=(n+1)/2;
+    Eigen::VectorXd u1(half),u2(half);
+    fill_uniform(u1);
+    fill_uniform(u2);
+    Eigen::ArrayXd radius=(-2.0*u1.array().log()).sqrt();
+    Eigen::ArrayXd angle=TWO_PI*u2.array();
+    Eigen::ArrayXd values(2*half);
+    values.head(half)=radius*angle.cos();
+    values.tail(half)=radius*angle.sin();
+    for(int j=0;j<out.cols();j++){
+        out.col(j)=values.segment(j*out.rows(),out.rows()).matrix();
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file random.hpp
+ * @brief counter-based (Philox4x32-10) random streams
+ * @details Every sampler draws from its own RandomStream. Streams are keyed by
+ * the global seed and a stream id, so a run is reproducible from a single seed
+ * (TRACKER_SEED environment variable, or set_random_seed) and streams can be
+ * split per filter, particle block or thread without sharing state.
+ *
+ * Default-constructed streams take the next id of a global counter, which
+ * only reproduces a run when everything is built in a fixed order. Code that
+ * builds several runs concurrently opens a random_scope per run: streams
+ * default-constructed on that thread while the scope is alive are split from
+ * the scope's own stream instead, so each run depends on its key only.
+ */
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+#include <cmath>
+#include <Eigen/Core>
+
+uint64_t random_seed();
+void set_random_seed(uint64_t seed);
+uint64_t next_stream_id();
+
+class RandomStream {
+public:
+    typedef uint32_t result_type;
+    RandomStream();
+    RandomStream(uint64_t _seed, uint64_t _stream);
+    void seed(uint64_t _seed, uint64_t _stream);
+    RandomStream split(uint64_t substream) const;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xFFFFFFFFu; }
+    inline result_type operator()(){
+        if(index==4){
+            generate_block();
+        }
+        return block[index++];
+    }
+    double uniform();
+    double normal();
+    void fill_uniform(Eigen::Ref<Eigen::MatrixXf> out);
+    void fill_uniform(Eigen::Ref<Eigen::MatrixXd> out);
+    void fill_normal(Eigen::Ref<Eigen::MatrixXf> out);
+    void fill_normal(Eigen::Ref<Eigen::MatrixXd> out);
+private:
+    void generate_block();
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int index;
+    bool has_spare;
+    double spare;
+};
+
+/* derives the default-constructed streams of the current thread from
+owner.split(substream), restores the enclosing scope when destroyed */
+class random_scope {
+public:
+    random_scope(const RandomStream& owner, uint64_t substream);
+    ~random_scope();
+    RandomStream next();
+private:
+    random_scope(const random_scope&);
+    random_scope& operator=(const random_scope&);
+    RandomStream root;
+    uint64_t count;
+    random_scope* enclosing;
+};
+
+#endif // RANDOM_H
@@ -0,0 +1,23 @@
+/**
+ * @file real.hpp
+ * @brief floating point type of the feature and likelihood pipeline
+ * @details Configure with -DTRACKER_FLOAT32 to run features, likelihoods and
+ * particle weights in single precision end to end; double is the default.
+ */
+#ifndef REAL_H
+#define REAL_H
+
+#include <Eigen/Core>
+
+#ifdef TRACKER_FLOAT32
+typedef float real_t;
+#else
+typedef double real_t;
+#endif
+
+typedef Eigen::Matrix<real_t,Eigen::Dynamic,Eigen::Dynamic> MatrixXr;
+typedef Eigen::Matrix<real_t,Eigen::Dynamic,1> VectorXr;
+typedef Eigen::Matrix<real_t,1,Eigen::Dynamic> RowVectorXr;
+typedef Eigen::Array<real_t,Eigen::Dynamic,1> ArrayXr;
+
+#endif // REAL_H
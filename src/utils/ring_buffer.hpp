@@ -0,0 +1,67 @@
+/**
+ * @file ring_buffer.hpp
+ * @brief fixed-capacity circular buffer
+ * @details All slots are allocated by reset(), pushing into a full buffer
+ * overwrites the oldest element in place. push_back() without an argument
+ * hands out the recycled slot, so elements that own storage (vectors,
+ * matrices) keep their allocation from one lap to the next.
+ */
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <vector>
+
+using namespace std;
+
+template<class T>
+class ring_buffer {
+public:
+    ring_buffer(){
+        head=0;
+        count=0;
+    }
+    ring_buffer(int _capacity){
+        reset(_capacity);
+    }
+    /** preallocates _capacity slots and empties the buffer */
+    void reset(int _capacity){
+        slots.resize(_capacity>0 ? _capacity : 0);
+        head=0;
+        count=0;
+    }
+    void clear(){
+        head=0;
+        count=0;
+    }
+    int capacity() const { return slots.size(); }
+    int size() const { return count; }
+    bool empty() const { return count==0; }
+    bool full() const { return count==capacity(); }
+    /** slot of the new newest element, the oldest one when full, left as it was */
+    T& push_back(){
+        if(full()){
+            T& slot=slots[head];
+            head=(head+1)%capacity();
+            return slot;
+        }
+        count++;
+        return back();
+    }
+    void push_back(const T& value){
+        push_back()=value;
+    }
+    /** element i, 0 is the oldest and size()-1 the newest */
+    T& operator[](int i){ return slots[(head+i)%capacity()]; }
+    const T& operator[](int i) const { return slots[(head+i)%capacity()]; }
+    T& front(){ return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+    T& back(){ return (*this)[count-1]; }
+    const T& back() const { return (*this)[count-1]; }
+
+private:
+    vector<T> slots;
+    int head; /** slot of the oldest element */
+    int count;
+};
+
+#endif // RING_BUFFER_H
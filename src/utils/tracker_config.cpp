@@ -0,0 +1,116 @@
+/**
+ * @file tracker_config.cpp
+ * @brief runtime configuration of the tracker
+ */
+#include "tracker_config.hpp"
+#include "random.hpp"
+#include <fstream>
+#include <sstream>
+
+static const char* FEATURE_NAMES[]={"haar","lbp","mb_lbp","hog","compressive","color"};
+static const char* LIKELIHOOD_NAMES[]={"gnb","lr","mnb","boost","bhattacharyya"};
+static const char* SAMPLER_NAMES[]={"nuts","hmc","sgmc","laplace"};
+static const char* RESAMPLER_NAMES[]={"multinomial","systematic"};
+
+static int find_name(const string& name, const char* names[], int n_names){
+    for(int i=0;i<n_names;i++){
+        if(name==names[i]) return i;
+    }
+    return -1;
+}
+
+TrackerConfig::TrackerConfig(){
+    feature=FEATURE_HAAR;
+    likelihood=LIKELIHOOD_GAUSSIAN_NAIVEBAYES;
+    sampler=SAMPLER_NUTS;
+    resampler=RESAMPLER_MULTINOMIAL;
+    n_particles=300;
+    fixed_lag=0;
+    seed=random_seed();
+}
+
+/* same contract as TrackerParams::set */
+int TrackerConfig::set(const string& key, istream& value){
+    string name;
+    int index;
+    if(key=="feature"){
+        if(!(value >> name) || (index=find_name(name,FEATURE_NAMES,6))<0) return 0;
+        feature=(feature_type)index;
+    }
+    else if(key=="likelihood"){
+        if(!(value >> name) || (index=find_name(name,LIKELIHOOD_NAMES,5))<0) return 0;
+        likelihood=(likelihood_type)index;
+    }
+    else if(key=="sampler"){
+        if(!(value >> name) || (index=find_name(name,SAMPLER_NAMES,4))<0) return 0;
+        sampler=(sampler_type)index;
+    }
+    else if(key=="resampler"){
+        if(!(value >> name) || (index=find_name(name,RESAMPLER_NAMES,2))<0) return 0;
+        resampler=(resampler_type)index;
+    }
+    else if(key=="particles" || key=="npart"){
+        if(!(value >> n_particles) || n_particles<=0) return 0;
+    }
+    else if(key=="lag"){
+        if(!(value >> fixed_lag) || fixed_lag<0) return 0;
+    }
+    else if(key=="seed"){
+        if(!(value >> seed)) return 0;
+    }
+    else return params.set(key,value);
+    return 1;
+}
+
+bool TrackerConfig::load(const string& filename){
+    // the pipeline keys are handled by set, the rest goes to TrackerParams
+    return load_key_values(filename,[this](const string& key, istream& value){ return set(key,value); });
+}
+
+/* "-key value" pairs, applied in order, so "-config file" followed by other
+options overrides the file */
+bool TrackerConfig::parse_args(int argc, char* argv[]){
+    for(int i=0;i<argc;i+=2){
+        if(argv[i][0]!='-' || i+1>=argc){
+            cout << "Error: expected -key value, got " << argv[i] << endl;
+            return false;
+        }
+        string key(argv[i]+1);
+        if(key=="config" || key=="params"){
+            if(!load(argv[i+1])) return false;
+            continue;
+        }
+        istringstream value(argv[i+1]);
+        int parsed=set(key,value);
+        if(parsed<0){
+            cout << "Error: unknown option " << argv[i] << endl;
+            return false;
+        }
+        if(parsed==0){
+            cout << "Error: bad value for " << argv[i] << ": " << argv[i+1] << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TrackerConfig::save(const string& filename) const{
+    ofstream file(filename.c_str());
+    if(!file.is_open()){
+        cout << "Error: cannot write configuration file " << filename << endl;
+        return false;
+    }
+    print(file);
+    return file.good();
+}
+
+void TrackerConfig::print(ostream& out) const{
+    out << "feature " << FEATURE_NAMES[feature] << endl;
+    out << "likelihood " << LIKELIHOOD_NAMES[likelihood] << endl;
+    out << "sampler " << SAMPLER_NAMES[sampler] << endl;
+    out << "resampler " << RESAMPLER_NAMES[resampler] << endl;
+    out << "particles " << n_particles << endl;
+    out << "lag " << fixed_lag << endl;
+    out << "seed " << seed << endl;
+    params.print(out);
+}
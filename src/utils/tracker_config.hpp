@@ -0,0 +1,42 @@
+/**
+ * @file tracker_config.hpp
+ * @brief runtime configuration of the tracker
+ * @details Selects the feature, the likelihood and the logistic regression
+ * backend of the observation model, on top of the numeric TrackerParams.
+ * Same "key value" file format as TrackerParams, so a tuned parameter file is
+ * a valid configuration file; every key can also be given on the command line
+ * as "-key value".
+ */
+#ifndef TRACKER_CONFIG_H
+#define TRACKER_CONFIG_H
+
+#include <stdint.h>
+#include <string>
+#include <iostream>
+#include "tracker_params.hpp"
+
+using namespace std;
+
+enum feature_type { FEATURE_HAAR, FEATURE_LBP, FEATURE_MB_LBP, FEATURE_HOG, FEATURE_COMPRESSIVE, FEATURE_COLOR };
+enum likelihood_type { LIKELIHOOD_GAUSSIAN_NAIVEBAYES, LIKELIHOOD_LOGISTIC_REGRESSION, LIKELIHOOD_MULTINOMIAL_NAIVEBAYES, LIKELIHOOD_ADABOOST, LIKELIHOOD_BHATTACHARYYA };
+enum sampler_type { SAMPLER_NUTS, SAMPLER_HMC, SAMPLER_SGMC, SAMPLER_LAPLACE };
+enum resampler_type { RESAMPLER_MULTINOMIAL, RESAMPLER_SYSTEMATIC };
+
+typedef struct TrackerConfig {
+    TrackerParams params;
+    feature_type feature; /** haar, lbp, mb_lbp, hog, compressive or color */
+    likelihood_type likelihood; /** gnb, lr, mnb, boost or bhattacharyya */
+    sampler_type sampler; /** lr posterior: nuts, hmc, sgmc or laplace */
+    resampler_type resampler; /** multinomial or systematic */
+    int n_particles;
+    int fixed_lag; /** filtering steps kept for smoothing, 0 keeps none */
+    uint64_t seed;
+    TrackerConfig();
+    int set(const string& key, istream& value);
+    bool load(const string& filename);
+    bool parse_args(int argc, char* argv[]);
+    bool save(const string& filename) const;
+    void print(ostream& out) const;
+} TrackerConfig;
+
+#endif // TRACKER_CONFIG_H
@@ -0,0 +1,85 @@
+/**
+ * @file tracker_params.cpp
+ * @brief runtime parameters of the particle filter tracker
+ */
+#include "tracker_params.hpp"
+#include <fstream>
+#include <sstream>
+
+TrackerParams::TrackerParams(){
+    // hand-tuned defaults
+    pos_std=1.0;
+    scale_std=1.0;
+    threshold=1.0;
+    overlap_ratio=0.8;
+    learning_rate=0.2;
+    haar_features=30;
+    haar_pool=200;
+}
+
+/* reads the value of key from the stream, returns 1 on success, 0 on a bad
+value and -1 when the key is not a tracker parameter */
+int TrackerParams::set(const string& key, istream& value){
+    bool parsed;
+    if(key=="pos_std") parsed=(bool)(value >> pos_std);
+    else if(key=="scale_std") parsed=(bool)(value >> scale_std);
+    else if(key=="threshold") parsed=(bool)(value >> threshold);
+    else if(key=="overlap_ratio") parsed=(bool)(value >> overlap_ratio);
+    else if(key=="learning_rate") parsed=(bool)(value >> learning_rate);
+    else if(key=="haar_features") parsed=(bool)(value >> haar_features);
+    else if(key=="haar_pool") parsed=(bool)(value >> haar_pool);
+    else return -1;
+    return parsed ? 1 : 0;
+}
+
+bool TrackerParams::load(const string& filename){
+    return load_key_values(filename,[this](const string& key, istream& value){ return set(key,value); });
+}
+
+bool load_key_values(const string& filename, const function<int(const string&, istream&)>& set){
+    ifstream file(filename.c_str());
+    if(!file.is_open()){
+        cout << "Error: cannot open parameter file " << filename << endl;
+        return false;
+    }
+    string line;
+    int line_number=0;
+    while(getline(file,line)){
+        line_number++;
+        size_t comment=line.find('#');
+        if(comment!=string::npos) line.erase(comment);
+        istringstream fields(line);
+        string key;
+        if(!(fields >> key)) continue;
+        int parsed=set(key,fields);
+        if(parsed<0){
+            cout << "Error: unknown parameter " << key << " (" << filename << ":" << line_number << ")" << endl;
+            continue;
+        }
+        if(parsed==0){
+            cout << "Error: bad value for " << key << " (" << filename << ":" << line_number << ")" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TrackerParams::save(const string& filename) const{
+    ofstream file(filename.c_str());
+    if(!file.is_open()){
+        cout << "Error: cannot write parameter file " << filename << endl;
+        return false;
+    }
+    print(file);
+    return file.good();
+}
+
+void TrackerParams::print(ostream& out) const{
+    out << "pos_std " << pos_std << endl;
+    out << "scale_std " << scale_std << endl;
+    out << "threshold " << threshold << endl;
+    out << "overlap_ratio " << overlap_ratio << endl;
+    out << "learning_rate " << learning_rate << endl;
+    out << "haar_features " << haar_features << endl;
+    out << "haar_pool " << haar_pool << endl;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file tracker_params.hpp
+ * @brief runtime parameters of the particle filter tracker
+ * @details Plain "key value" text file, one parameter per line, '#' starts a
+ * comment. Keys not present in the file keep their default value.
+ */
+#ifndef TRACKER_PARAMS_H
+#define TRACKER_PARAMS_H
+
+#include <string>
+#include <iostream>
+#include <functional>
+
+using namespace std;
+
+typedef struct TrackerParams {
+    float pos_std; /** random walk std of the box position */
+    float scale_std; /** random walk std of the box scale */
+    float threshold; /** resample when ESS/n_particles falls below it */
+    float overlap_ratio; /** max overlap of a negative example with the target */
+    float learning_rate; /** forgetting factor of the online model update */
+    int haar_features; /** Haar features evaluated per box */
+    int haar_pool; /** Haar candidates ranked online, the best haar_features are evaluated */
+    TrackerParams();
+    int set(const string& key, istream& value);
+    bool load(const string& filename);
+    bool save(const string& filename) const;
+    void print(ostream& out) const;
+} TrackerParams;
+
+/** reads a "key value" file and hands every key to set, which follows the
+contract of TrackerParams::set; unknown keys are reported and skipped */
+bool load_key_values(const string& filename, const function<int(const string&, istream&)>& set);
+
+#endif // TRACKER_PARAMS_H
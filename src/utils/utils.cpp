@@ -104,6 +104,38 @@ float fastdigamma (float x)
          + logterm;
 }
 
+/* log Gamma for x > 0: the recurrence lifts x above 7, where the Stirling
+series with three correction terms is within 1e-9, so it costs two logs and
+no library lgamma call */
+double fastlgamma (double x)
+{
+  double shift = 1.0;
+  while (x < 7.0) {
+    shift *= x;
+    x += 1.0;
+  }
+  double inv = 1.0 / x;
+  double inv2 = inv * inv;
+  double series = inv * (1.0/12.0 - inv2 * (1.0/360.0 - inv2 * (1.0/1260.0)));
+  return (x - 0.5) * std::log(x) - x + 0.91893853320467274 + series - std::log(shift);
+}
+
+/* log k! = lgamma(k+1), the small integers of histogram bins come from a
+table built on first use */
+double log_factorial (double k)
+{
+  static const int TABLE_SIZE = 256;
+  static const vector<double> table = [](){
+    vector<double> values(TABLE_SIZE);
+    values[0] = 0.0;
+    for (int n = 1; n < TABLE_SIZE; n++) values[n] = values[n-1] + std::log((double)n);
+    return values;
+  }();
+  int n = (int)k;
+  if (n == k && n >= 0 && n < TABLE_SIZE) return table[n];
+  return fastlgamma(k + 1.0);
+}
+
 MatrixXd psi(const Ref<const MatrixXd>& mat){
     MatrixXd res(mat.rows(),mat.cols());
 
@@ -161,15 +193,16 @@ double quad_root(double a, double b, double c){
     return std::max((-b + top) / (2 * a), (-b - top) / (2 * a));
 }
 
+/* drops the rows without counts in one pass, kept rows move up in order */
 void removeNoTrials(MatrixXd& counts){
-    MatrixXd auxCounts = counts.rowwise().sum();
-    for(int i=0;i<auxCounts.rows();i++){
-         if(auxCounts(i,0)<0){
-            removeRow(auxCounts,i);
-            removeRow(counts,i);
-            i--;
-         }
+    int kept=0;
+    for(int i=0;i<counts.rows();i++){
+        if(counts.row(i).sum()>0){
+            if(kept!=i) counts.row(kept)=counts.row(i);
+            kept++;
+        }
     }
+    counts.conservativeResize(kept,NoChange);
 }
 
 double trigamma(double x){
@@ -39,6 +39,8 @@ double median(const Eigen::Ref<const Eigen::MatrixXd>& med);
 float fastlog2 (float x);
 float fastlog (float x);
 float fastdigamma (float x);
+double fastlgamma (double x);
+double log_factorial (double k);
 Eigen::MatrixXd psi(const Eigen::Ref<const Eigen::MatrixXd>& mat);
 float psi(float x);
 double* linspace(double min, double max, int n);